@@ -0,0 +1,31 @@
+#include "allocation.h"
+
+
+// adding and removing 2^52 rounds any smaller non-negative double to a whole number
+const double __ROUNDING_MAGIC__{4503599627370496.0};
+
+/*
+* Written without calls or branches so the loop vectorises: floor() and plain
+* comparisons are not if-converted under the default trapping-math rules, so
+* rounding uses the 2^52 trick and comparisons use quiet builtins.
+*/
+__attribute__((target_clones("avx2", "default")))
+void proRataAllocate(
+    const double* __restrict quantities,
+    double* __restrict allocations,
+    size_t count,
+    double total_volume,
+    double quantity)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        double exact = quantities[i] * quantity;
+        double share = exact / total_volume;
+        double whole = (share + __ROUNDING_MAGIC__) - __ROUNDING_MAGIC__;
+        whole -= __builtin_isgreater(whole, share);
+
+        // a quotient rounded up to a whole lot overshoots by one; products are exact
+        whole -= __builtin_isgreater(whole * total_volume, exact);
+        allocations[i] = whole;
+    }
+}
@@ -0,0 +1,23 @@
+#include <cstddef>
+
+
+#ifndef ALLOCATION_H
+#define ALLOCATION_H
+
+/*
+* Pro-rata share of an incoming quantity for each resting quantity at a level.
+*
+* Quantities are held as doubles (exact for whole lots below 2^53) in
+* contiguous arrays so the pass is vectorised; an AVX2 clone is picked at load
+* time when the CPU supports it. Each share is floor(q * quantity / total), so
+* the shares sum to at most quantity and the caller distributes what is left.
+*/
+void proRataAllocate(
+    const double* quantities,
+    double* allocations,
+    size_t count,
+    double total_volume,
+    double quantity
+);
+
+#endif
@@ -0,0 +1,139 @@
+#include <new>
+#include <algorithm>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "arena.h"
+
+
+const size_t __PAGE_SIZE__{4096};
+
+/* Index of the smallest power-of-two class (from 16 bytes) that fits size */
+static int sizeClass(size_t size)
+{
+    size = std::max<size_t>(size, 16);
+    return 64 - __builtin_clzll(size - 1) - 4;
+}
+
+static size_t roundUp(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+Arena::Arena(size_t chunk_size)
+    :chunk_size{roundUp(std::max<size_t>(chunk_size, 1), __HUGE_PAGE_SIZE__)}
+{
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    {
+        _node = node;
+    }
+
+    mapChunk(this->chunk_size);
+}
+
+Arena::~Arena()
+{
+    for (Chunk& chunk : chunks)
+    {
+        munmap(chunk.base, chunk.size);
+    }
+}
+
+void Arena::mapChunk(size_t size)
+{
+    size = roundUp(size, __HUGE_PAGE_SIZE__);
+    ArenaBacking backing = ArenaBacking::HugeTLB;
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr == MAP_FAILED)
+    {
+        // hugetlb pool is empty: over-map so the chunk can start on a 2MB
+        // boundary, which transparent huge pages need to back it
+        size_t span = size + __HUGE_PAGE_SIZE__;
+        void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        char* start = static_cast<char*>(raw);
+        char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(start), __HUGE_PAGE_SIZE__));
+        if (aligned > start)
+            munmap(start, aligned - start);
+        if (start + span > aligned + size)
+            munmap(aligned + size, (start + span) - (aligned + size));
+
+        addr = aligned;
+        backing = madvise(addr, size, MADV_HUGEPAGE) == 0 ? ArenaBacking::Transparent : ArenaBacking::Regular;
+    }
+
+    // bind before the first touch so pages are faulted on the owner's node
+    if (_node >= 0 && _node < 64)
+    {
+        unsigned long mask = 1ul << _node;
+        syscall(SYS_mbind, addr, size, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+    }
+
+    // pre-fault every page so the matching thread never takes a fault
+    volatile char* base = static_cast<char*>(addr);
+    for (size_t offset = 0; offset < size; offset += __PAGE_SIZE__)
+    {
+        base[offset] = 0;
+    }
+
+    // report the weakest backing across all chunks
+    if (chunks.empty() || backing > _backing)
+        _backing = backing;
+
+    chunks.push_back(Chunk{static_cast<char*>(addr), size});
+    cursor = static_cast<char*>(addr);
+    limit = cursor + size;
+    _reserved += size;
+}
+
+void* Arena::allocate(size_t size)
+{
+    int size_class = sizeClass(size);
+    if (size_class >= __ARENA_CLASSES__)
+    {
+        throw std::bad_alloc();
+    }
+
+    size_t block = size_t{16} << size_class;
+    _used += block;
+
+    void* head = free_lists[size_class];
+    if (head != nullptr)
+    {
+        free_lists[size_class] = *static_cast<void**>(head);
+        return head;
+    }
+
+    // blocks are aligned to their size up to a cache line
+    cursor = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(cursor), std::min<size_t>(block, 64)));
+    if (cursor + block > limit)
+    {
+        // the tail of the current chunk is abandoned
+        mapChunk(std::max(chunk_size, block));
+    }
+
+    void* ptr = cursor;
+    cursor += block;
+    return ptr;
+}
+
+void Arena::deallocate(void* ptr, size_t size)
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+
+    int size_class = sizeClass(size);
+    *static_cast<void**>(ptr) = free_lists[size_class];
+    free_lists[size_class] = ptr;
+    _used -= size_t{16} << size_class;
+}
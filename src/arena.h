@@ -0,0 +1,122 @@
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+const size_t __HUGE_PAGE_SIZE__{2 * 1024 * 1024};
+const size_t __ARENA_CHUNK_SIZE__{64 * 1024 * 1024};
+
+enum class ArenaBacking {
+    // explicit 2MB pages from the hugetlb pool
+    HugeTLB,
+    // transparent huge pages requested with madvise
+    Transparent,
+    // regular 4KB pages
+    Regular,
+};
+
+/*
+* Per-book memory arena backed by 2MB pages where available.
+*
+* Chunks are mapped with MAP_HUGETLB, falling back to transparent huge pages and
+* then regular pages. They are bound to the NUMA node of the constructing thread
+* and pre-faulted so matching never takes a page fault. Allocations are served
+* from power-of-two size classes with per-class free lists, each block aligned
+* to its size up to a cache line.
+*
+* Not thread-safe: an arena belongs to the thread that owns its book and must
+* outlive every container allocating from it.
+*/
+class Arena {
+public:
+    Arena(size_t chunk_size=__ARENA_CHUNK_SIZE__);
+
+    Arena(const Arena& a) = delete;
+    Arena& operator=(const Arena& a) = delete;
+
+    ~Arena();
+
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+
+    ArenaBacking backing() const { return _backing; };
+    int node() const { return _node; };
+    size_t reserved() const { return _reserved; };
+    size_t used() const { return _used; };
+
+private:
+    struct Chunk {
+        char* base;
+        size_t size;
+    };
+
+    // size classes 2^4 .. 2^(4 + __ARENA_CLASSES__ - 1)
+    static const int __ARENA_CLASSES__{40};
+
+    size_t chunk_size;
+    ArenaBacking _backing{ArenaBacking::Regular};
+    int _node{-1};
+    size_t _reserved{0};
+    size_t _used{0};
+
+    std::vector<Chunk> chunks;
+    char* cursor{nullptr};
+    char* limit{nullptr};
+    void* free_lists[__ARENA_CLASSES__]{};
+
+    void mapChunk(size_t size);
+};
+
+/*
+* STL allocator drawing from an Arena. A null arena uses the global heap so
+* containers can take the same type whether or not a book has an arena. When
+* given a counter, it keeps the bytes currently allocated through it there.
+*/
+template<typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator(Arena* arena=nullptr, size_t* counter=nullptr) noexcept
+        :arena{arena},
+        counter{counter} {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+        :arena{other.arena},
+        counter{other.counter} {}
+
+    T* allocate(size_t n)
+    {
+        if (counter != nullptr)
+            *counter += n * sizeof(T);
+        if (arena == nullptr)
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+        return static_cast<T*>(arena->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n)
+    {
+        if (counter != nullptr)
+            *counter -= n * sizeof(T);
+        if (arena == nullptr)
+            ::operator delete(ptr, std::align_val_t{alignof(T)});
+        else
+            arena->deallocate(ptr, n * sizeof(T));
+    }
+
+    Arena* arena;
+    size_t* counter;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena && a.counter == b.counter; }
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return !(a == b); }
+
+#endif
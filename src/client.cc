@@ -0,0 +1,245 @@
+#include <stdexcept>
+
+#include "client.h"
+
+
+// exception escaped from a task on this thread, rethrown by poll()
+static thread_local std::exception_ptr client_task_exception;
+
+FramePool::~FramePool()
+{
+    for (void* slab : _slabs)
+    {
+        ::operator delete(slab);
+    }
+}
+
+FramePool& FramePool::local()
+{
+    static thread_local FramePool pool;
+    return pool;
+}
+
+void* FramePool::allocate(size_t size)
+{
+    if (size > __CLIENT_FRAME_SIZE__)
+    {
+        return ::operator new(size);
+    }
+
+    if (free_head == nullptr)
+    {
+        char* slab = static_cast<char*>(::operator new(__CLIENT_FRAME_SIZE__ * __CLIENT_FRAME_SLAB__));
+        _slabs.push_back(slab);
+        for (size_t i = __CLIENT_FRAME_SLAB__; i > 0; i--)
+        {
+            Block* block = reinterpret_cast<Block*>(slab + (i - 1) * __CLIENT_FRAME_SIZE__);
+            block->next = free_head;
+            free_head = block;
+        }
+    }
+
+    Block* block = free_head;
+    free_head = block->next;
+    _live++;
+    return block;
+}
+
+void FramePool::deallocate(void* frame, size_t size)
+{
+    if (size > __CLIENT_FRAME_SIZE__)
+    {
+        ::operator delete(frame);
+        return;
+    }
+
+    Block* block = static_cast<Block*>(frame);
+    block->next = free_head;
+    free_head = block;
+    _live--;
+}
+
+void ClientTask::promise_type::unhandled_exception() noexcept
+{
+    client_task_exception = std::current_exception();
+}
+
+
+void SubmitAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    this->handle = handle;
+    client.post(*this);
+}
+
+AsyncClient::AsyncClient(MatchingEngine& engine)
+    :engine{engine},
+    slots{std::make_unique<SubmitAwaiter*[]>(__CLIENT_QUEUE_SIZE__)}
+{
+    // lowest slots handed out first
+    for (uint32_t slot = __CLIENT_QUEUE_SIZE__; slot > 0; slot--)
+    {
+        free_slots.push_back(slot - 1);
+    }
+}
+
+void AsyncClient::post(SubmitAwaiter& awaiter)
+{
+    if (free_slots.empty())
+    {
+        awaiter.next = nullptr;
+        if (waiting_tail != nullptr)
+            waiting_tail->next = &awaiter;
+        else
+            waiting_head = &awaiter;
+        waiting_tail = &awaiter;
+        return;
+    }
+
+    uint32_t slot = free_slots.back();
+    free_slots.pop_back();
+    slots[slot] = &awaiter;
+
+    // a free slot means the request queue has room
+    requests.push(ClientRequest{slot, awaiter.order});
+}
+
+size_t AsyncClient::poll()
+{
+    size_t resumed = 0;
+    ClientResponse response;
+    while (responses.pop(response))
+    {
+        SubmitAwaiter* awaiter = slots[response.slot];
+        awaiter->result = response.result;
+        free_slots.push_back(response.slot);
+
+        // hand the slot on before resuming, which may submit again
+        if (waiting_head != nullptr)
+        {
+            SubmitAwaiter* waiting = waiting_head;
+            waiting_head = waiting->next;
+            if (waiting_head == nullptr)
+                waiting_tail = nullptr;
+            post(*waiting);
+        }
+
+        awaiter->handle.resume();
+        resumed++;
+
+        if (client_task_exception != nullptr)
+        {
+            std::exception_ptr exception = client_task_exception;
+            client_task_exception = nullptr;
+            std::rethrow_exception(exception);
+        }
+    }
+    return resumed;
+}
+
+void AsyncClient::run()
+{
+    while (!idle())
+    {
+        if (poll() == 0)
+            std::this_thread::yield();
+    }
+}
+
+
+MatchingEngine::MatchingEngine(OrderBook& orderbook)
+    :orderbook{orderbook}
+{}
+
+MatchingEngine::~MatchingEngine()
+{
+    stop();
+}
+
+AsyncClient& MatchingEngine::connect()
+{
+    if (running)
+    {
+        throw std::logic_error("Clients must connect before the engine starts.");
+    }
+    clients.push_back(std::make_unique<AsyncClient>(*this));
+    return *clients.back();
+}
+
+void MatchingEngine::start()
+{
+    if (running)
+    {
+        return;
+    }
+    running = true;
+    matcher = std::thread{&MatchingEngine::matchLoop, this};
+}
+
+void MatchingEngine::stop()
+{
+    running = false;
+    if (matcher.joinable())
+    {
+        matcher.join();
+    }
+}
+
+void MatchingEngine::matchLoop()
+{
+    while (running)
+    {
+        size_t handled = 0;
+        for (auto& client : clients)
+        {
+            ClientRequest request;
+            for (size_t i = 0; i < __CLIENT_MATCH_BATCH__ && client->requests.pop(request); i++)
+            {
+                handle(*client, request);
+                handled++;
+            }
+        }
+
+        if (handled == 0)
+        {
+            // quiet period: give memory back a step at a time
+            if (!orderbook.compact())
+                std::this_thread::yield();
+        }
+    }
+}
+
+void MatchingEngine::handle(AsyncClient& client, const ClientRequest& request)
+{
+    traceBegin();
+    const ClientOrder& order = request.order;
+    SubmitResult result{0, 0, 0, false};
+
+    // resting quantities and level prices are 32 bits
+    if (order.quantity == 0 || order.price == 0 || order.price > UINT32_MAX
+        || order.quantity > UINT32_MAX || order.peak > UINT32_MAX)
+    {
+        result.rejected = true;
+    }
+    else {
+        bool iceberg = order.peak != 0 && order.peak < order.quantity;
+        try {
+            Order incoming = iceberg
+                ? orderbook.createIcebergOrder(order.is_bid, order.quantity, order.peak, order.price, order.owner)
+                : orderbook.createLevelOrder(order.is_bid, order.quantity, 0, order.price, order.owner);
+            orderbook.addOrder(incoming);
+            result = SubmitResult{incoming.id(), incoming.filled_quantity(), incoming.filled_cost(), false};
+        }
+        catch (...) {
+            // nothing may escape the matching thread. Validation throws before
+            // matching, but a later failure such as an allocation may leave
+            // fills already applied to the book
+            result.rejected = true;
+        }
+    }
+
+    // in-flight requests never outnumber the response queue's slots
+    client.responses.push(ClientResponse{request.slot, result});
+    tracePoint(TraceStage::Ack);
+    traceEnd();
+    _messages.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,204 @@
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "orderbook.h"
+#include "spsc_queue.h"
+#include "trace.h"
+
+
+#ifndef CLIENT_H
+#define CLIENT_H
+
+// requests a client may have in flight, and the size of both its queues
+const size_t __CLIENT_QUEUE_SIZE__{4096};
+const size_t __CLIENT_MATCH_BATCH__{256};
+// pooled coroutine frames: block size and blocks per slab
+const size_t __CLIENT_FRAME_SIZE__{512};
+const size_t __CLIENT_FRAME_SLAB__{256};
+
+/* Limit order submitted through an AsyncClient, price in level units */
+struct ClientOrder {
+    bool is_bid;
+    uint64_t quantity;
+    uint64_t price;
+    uint64_t owner{0};
+    // shown quantity of an iceberg, 0 for a plain order
+    uint64_t peak{0};
+};
+
+/*
+* Acknowledgement of a submitted order with the fills it took on entry.
+* Orders with a zero quantity or price, or a price, quantity or peak above
+* 32 bits, are rejected without touching the book.
+*/
+struct SubmitResult {
+    uint64_t order_id;
+    uint64_t filled_quantity;
+    uint64_t filled_cost;
+    bool rejected;
+};
+
+struct ClientRequest {
+    uint32_t slot;
+    ClientOrder order;
+};
+
+struct ClientResponse {
+    uint32_t slot;
+    SubmitResult result;
+};
+
+/*
+* Per-thread free list of fixed-size coroutine frames, grown a slab at a time
+* and never shrunk, so a steady stream of tasks allocates nothing. Larger
+* frames fall back to the heap. Frames must be freed on the thread that
+* allocated them, before it exits.
+*/
+class FramePool {
+public:
+    FramePool() = default;
+
+    FramePool(const FramePool& p) = delete;
+    FramePool& operator=(const FramePool& p) = delete;
+
+    ~FramePool();
+
+    static FramePool& local();
+
+    void* allocate(size_t size);
+    void deallocate(void* frame, size_t size);
+
+    size_t slabs() const { return _slabs.size(); };
+    size_t live() const { return _live; };
+
+private:
+    struct Block {
+        Block* next;
+    };
+
+    Block* free_head{nullptr};
+    std::vector<void*> _slabs;
+    size_t _live{0};
+};
+
+/*
+* Fire-and-forget coroutine for strategy code running on a client thread.
+* It starts eagerly, runs until its first co_await and is resumed by
+* AsyncClient::poll(). Frames come from the thread's FramePool. An exception
+* escaping the task is rethrown from the next poll() on that thread.
+*/
+struct ClientTask {
+    struct promise_type {
+        ClientTask get_return_object() noexcept { return {}; };
+        std::suspend_never initial_suspend() noexcept { return {}; };
+        std::suspend_never final_suspend() noexcept { return {}; };
+        void return_void() noexcept {};
+        void unhandled_exception() noexcept;
+
+        static void* operator new(size_t size) { return FramePool::local().allocate(size); };
+        static void operator delete(void* frame, size_t size) { FramePool::local().deallocate(frame, size); };
+    };
+};
+
+class AsyncClient;
+
+/* Awaiter of one submitted order, living in the awaiting coroutine's frame */
+struct SubmitAwaiter {
+    AsyncClient& client;
+    ClientOrder order;
+    SubmitResult result{};
+    std::coroutine_handle<> handle{};
+    // queue of submits waiting for an in-flight slot
+    SubmitAwaiter* next{nullptr};
+
+    bool await_ready() const noexcept { return false; };
+    void await_suspend(std::coroutine_handle<> handle);
+    SubmitResult await_resume() const noexcept { return result; };
+};
+
+class MatchingEngine;
+
+/*
+* A client thread's connection to a MatchingEngine. Used only by that thread.
+*
+* co_await submit(order) posts the order to the engine's inbound queue and
+* suspends the task; poll() resumes it with the ack once matching is done.
+* Up to __CLIENT_QUEUE_SIZE__ orders are in flight at once. Further submits
+* wait in arrival order inside their own frames, so pipelining needs no
+* allocation beyond the task frames.
+*/
+class AsyncClient {
+public:
+    AsyncClient(MatchingEngine& engine);
+
+    AsyncClient(const AsyncClient& c) = delete;
+    AsyncClient& operator=(const AsyncClient& c) = delete;
+
+    SubmitAwaiter submit(const ClientOrder& order) { return SubmitAwaiter{*this, order}; };
+
+    /* Resumes every task whose ack has arrived and returns how many */
+    size_t poll();
+
+    /* Polls, yielding while nothing arrives, until no submit is outstanding */
+    void run();
+
+    size_t in_flight() const { return __CLIENT_QUEUE_SIZE__ - free_slots.size(); };
+    bool idle() const { return in_flight() == 0 && waiting_head == nullptr; };
+
+private:
+    friend class MatchingEngine;
+    friend struct SubmitAwaiter;
+
+    MatchingEngine& engine;
+    SPSCQueue<ClientRequest, __CLIENT_QUEUE_SIZE__> requests;
+    SPSCQueue<ClientResponse, __CLIENT_QUEUE_SIZE__> responses;
+
+    // awaiter of each in-flight request by slot
+    std::unique_ptr<SubmitAwaiter*[]> slots;
+    std::vector<uint32_t> free_slots;
+    SubmitAwaiter* waiting_head{nullptr};
+    SubmitAwaiter* waiting_tail{nullptr};
+
+    void post(SubmitAwaiter& awaiter);
+};
+
+/*
+* Runs a single OrderBook on its own matching thread for any number of
+* AsyncClients. Clients connect before start(). The matching thread owns the
+* book while running, takes a batch from each client's queue in turn and
+* acks every order with the fills it took on entry.
+*/
+class MatchingEngine {
+public:
+    MatchingEngine(OrderBook& orderbook);
+
+    MatchingEngine(const MatchingEngine& e) = delete;
+    MatchingEngine& operator=(const MatchingEngine& e) = delete;
+
+    ~MatchingEngine();
+
+    AsyncClient& connect();
+
+    void start();
+    /* Stops matching; tasks still awaiting an ack are never resumed */
+    void stop();
+
+    uint64_t messages() const { return _messages.load(std::memory_order_relaxed); };
+
+private:
+    OrderBook& orderbook;
+    std::vector<std::unique_ptr<AsyncClient>> clients;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> _messages{0};
+    std::thread matcher;
+
+    void matchLoop();
+    void handle(AsyncClient& client, const ClientRequest& request);
+};
+
+#endif
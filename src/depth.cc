@@ -0,0 +1,79 @@
+#include <algorithm>
+
+#include "depth.h"
+
+
+DepthCache::DepthCache(bool is_bid)
+    :is_bid{is_bid}
+{}
+
+void DepthCache::invalidate(uint64_t price)
+{
+    // cached prices are sorted from the inside, so keep the prefix before price
+    auto first = std::partition_point(entries.begin(), entries.end(), [&](const DepthLevel& level) {
+        return !beyond(level.price, price);
+    });
+    entries.erase(first, entries.end());
+}
+
+const Limit* DepthCache::nextLimit(const Limit* best) const
+{
+    return entries.empty() ? best : entries.back().limit->next;
+}
+
+void DepthCache::append(const Limit* limit)
+{
+    uint64_t volume = 0;
+    uint64_t notional = 0;
+    if (!entries.empty())
+    {
+        volume = entries.back().cumulative_volume;
+        notional = entries.back().cumulative_notional;
+    }
+
+    entries.push_back(DepthLevel{
+        limit,
+        limit->price(),
+        limit->visible_volume(),
+        volume + limit->visible_volume(),
+        notional + limit->price() * limit->visible_volume()
+    });
+}
+
+void DepthCache::extend(const Limit* best, size_t levels)
+{
+    for (const Limit* limit = nextLimit(best); limit != nullptr && entries.size() < levels; limit = limit->next)
+    {
+        append(limit);
+    }
+}
+
+void DepthCache::extendToPrice(const Limit* best, uint64_t price)
+{
+    if (!entries.empty() && beyond(entries.back().price, price))
+    {
+        return;
+    }
+
+    for (const Limit* limit = nextLimit(best); limit != nullptr; limit = limit->next)
+    {
+        append(limit);
+        if (beyond(limit->price(), price))
+            break;
+    }
+}
+
+void DepthCache::extendToVolume(const Limit* best, uint64_t volume)
+{
+    if (!entries.empty() && entries.back().cumulative_volume >= volume)
+    {
+        return;
+    }
+
+    for (const Limit* limit = nextLimit(best); limit != nullptr; limit = limit->next)
+    {
+        append(limit);
+        if (entries.back().cumulative_volume >= volume)
+            break;
+    }
+}
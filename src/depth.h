@@ -0,0 +1,66 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "limit.h"
+
+
+#ifndef DEPTH_H
+#define DEPTH_H
+
+/* A level with cumulative volume and notional from the inside of the book */
+struct DepthLevel {
+    const Limit* limit;
+    uint64_t price;
+    uint64_t volume;
+    uint64_t cumulative_volume;
+    uint64_t cumulative_notional;
+};
+
+/* Expected result of sweeping one side of the book with a quantity */
+struct FillEstimate {
+    uint64_t quantity;
+    uint64_t cost;
+    uint64_t worst_price;
+
+    double average_price() const { return quantity == 0 ? 0 : (double)cost / quantity; };
+};
+
+/*
+* Cumulative depth of one side of the book, built lazily from the inside out.
+*
+* The cache holds a valid prefix of levels. A change at a price only drops
+* cached levels at or beyond that price, so activity away from the inside
+* leaves the hot top of book cached. Queries extend the prefix by walking
+* Limit::next from the last cached level.
+*/
+class DepthCache {
+public:
+    DepthCache(bool is_bid);
+
+    /* Drops cached levels at price or further from the inside */
+    void invalidate(uint64_t price);
+
+    /* Extends the cache to at least `levels` levels, or every level */
+    void extend(const Limit* best, size_t levels);
+
+    /* Extends the cache until it covers price, or every level */
+    void extendToPrice(const Limit* best, uint64_t price);
+
+    /* Extends the cache until it holds volume, or every level */
+    void extendToVolume(const Limit* best, uint64_t volume);
+
+    const std::vector<DepthLevel>& levels() const { return entries; };
+
+    /* True if price a is at or further from the inside than price b */
+    bool beyond(uint64_t a, uint64_t b) const { return is_bid ? a <= b : a >= b; };
+
+private:
+    bool is_bid;
+    std::vector<DepthLevel> entries;
+
+    const Limit* nextLimit(const Limit* best) const;
+    void append(const Limit* limit);
+};
+
+#endif
@@ -0,0 +1,451 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "gateway.h"
+
+
+const unsigned __GATEWAY_RING_ENTRIES__{256};
+const int __GATEWAY_EPOLL_EVENTS__{64};
+
+// io_uring user data is tagged with the source of the completion
+const uint64_t __LISTEN_TAG__{1ull << 32};
+const uint64_t __WAKE_TAG__{2ull << 32};
+const uint64_t __CONNECTION_TAG__{3ull << 32};
+
+
+Gateway::Gateway(OrderBook& orderbook, uint16_t port, bool use_io_uring)
+    :orderbook{orderbook}
+{
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_fd == -1)
+    {
+        throw std::runtime_error("Unable to create gateway socket");
+    }
+
+    int enable = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) == -1 || listen(listen_fd, SOMAXCONN) == -1)
+    {
+        close(listen_fd);
+        throw std::runtime_error("Unable to listen on gateway port");
+    }
+
+    // report the bound port so callers can ask for an ephemeral one
+    socklen_t length = sizeof(addr);
+    getsockname(listen_fd, (sockaddr*)&addr, &length);
+    _port = ntohs(addr.sin_port);
+
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (wake_fd == -1)
+    {
+        close(listen_fd);
+        throw std::runtime_error("Unable to create gateway eventfd");
+    }
+
+    if (use_io_uring)
+    {
+        try {
+            ring = std::make_unique<IoUring>(__GATEWAY_RING_ENTRIES__);
+        }
+        catch (std::runtime_error& err) {
+            // fall back to epoll on kernels without io_uring
+            ring = nullptr;
+        }
+    }
+}
+
+Gateway::~Gateway()
+{
+    // tear down the ring first so no receive can land in a freed buffer
+    ring.reset();
+    for (uint32_t id = 0; id < connections.size(); id++)
+    {
+        closeConnection(id);
+    }
+    close(wake_fd);
+    close(listen_fd);
+}
+
+void Gateway::run()
+{
+    running = true;
+    std::thread matcher{&Gateway::matchLoop, this};
+
+    // the matcher is stopped and joined on every path, a joinable thread terminates
+    try {
+        if (ring != nullptr)
+            runIoUring();
+        else
+            runEpoll();
+    }
+    catch (...) {
+        running = false;
+        matcher.join();
+        throw;
+    }
+
+    running = false;
+    matcher.join();
+}
+
+void Gateway::stop()
+{
+    running = false;
+    uint64_t value = 1;
+    write(wake_fd, &value, sizeof(value));
+}
+
+uint32_t Gateway::openConnection(int fd)
+{
+    // sockets accepted through io_uring are blocking; acks are sent directly
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    Connection connection;
+    connection.fd = fd;
+    connection.buffer = std::make_unique<char[]>(__GATEWAY_BUFFER_SIZE__);
+    connections.push_back(std::move(connection));
+    return connections.size() - 1;
+}
+
+void Gateway::closeConnection(uint32_t id)
+{
+    Connection& connection = connections[id];
+    if (connection.fd == -1)
+    {
+        return;
+    }
+
+    // ids are never reused so late acks for this connection are dropped
+    close(connection.fd);
+    connection.fd = -1;
+    connection.buffer.reset();
+    connection.pending.clear();
+}
+
+void Gateway::decode(uint32_t id)
+{
+    Connection& connection = connections[id];
+    char* buffer = connection.buffer.get();
+
+    size_t offset = 0;
+    while (connection.length - offset >= sizeof(OrderMessage))
+    {
+        // messages always start at a multiple of 32 bytes so the cast is aligned
+        const OrderMessage* message = reinterpret_cast<const OrderMessage*>(buffer + offset);
+        GatewayRequest request{id, *message, tracingEnabled() ? traceCycles() : 0};
+        while (!inbound.push(request))
+        {
+            // matching thread may be blocked on a full outbound queue
+            flushResponses();
+        }
+        offset += sizeof(OrderMessage);
+    }
+
+    // keep any partial message at the front of the buffer
+    connection.length -= offset;
+    if (connection.length > 0 && offset > 0)
+    {
+        std::memmove(buffer, buffer + offset, connection.length);
+    }
+}
+
+void Gateway::flushResponses()
+{
+    GatewayResponse response;
+    while (outbound.pop(response))
+    {
+        Connection& connection = connections[response.connection];
+        if (connection.fd == -1)
+            continue;
+        if (connection.pending.empty())
+            dirty.push_back(response.connection);
+        connection.pending.push_back(response.message);
+    }
+
+    for (uint32_t id : dirty)
+    {
+        Connection& connection = connections[id];
+        const char* data = reinterpret_cast<const char*>(connection.pending.data());
+        size_t remaining = connection.pending.size() * sizeof(AckMessage);
+        while (remaining > 0 && connection.fd != -1)
+        {
+            ssize_t sent = send(connection.fd, data, remaining, MSG_NOSIGNAL);
+            if (sent > 0)
+            {
+                data += sent;
+                remaining -= sent;
+            }
+            else if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                pollfd pfd{connection.fd, POLLOUT, 0};
+                poll(&pfd, 1, 1);
+            }
+            else {
+                // io_uring still owns a receive on the socket; shutting it down
+                // completes that receive and the connection is closed from there
+                if (ring != nullptr)
+                    shutdown(connection.fd, SHUT_RDWR);
+                else
+                    closeConnection(id);
+                break;
+            }
+        }
+        connection.pending.clear();
+    }
+    dirty.clear();
+}
+
+void Gateway::runEpoll()
+{
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1)
+    {
+        throw std::runtime_error("Unable to create gateway epoll");
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = __LISTEN_TAG__;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.data.u64 = __WAKE_TAG__;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+    epoll_event events[__GATEWAY_EPOLL_EVENTS__];
+    while (running)
+    {
+        int ready = epoll_wait(epoll_fd, events, __GATEWAY_EPOLL_EVENTS__, -1);
+        for (int i = 0; i < ready; i++)
+        {
+            uint64_t tag = events[i].data.u64;
+            if (tag == __LISTEN_TAG__)
+            {
+                int fd;
+                while ((fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK)) != -1)
+                {
+                    uint32_t id = openConnection(fd);
+                    event.events = EPOLLIN;
+                    event.data.u64 = __CONNECTION_TAG__ | id;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+                }
+                continue;
+            }
+            if (tag == __WAKE_TAG__)
+            {
+                read(wake_fd, &wake_value, sizeof(wake_value));
+                continue;
+            }
+
+            // drain the socket so every message that arrived is batched now
+            uint32_t id = tag & 0xffffffff;
+            Connection& connection = connections[id];
+            while (connection.fd != -1)
+            {
+                ssize_t received = recv(
+                    connection.fd,
+                    connection.buffer.get() + connection.length,
+                    __GATEWAY_BUFFER_SIZE__ - connection.length,
+                    0
+                );
+                if (received > 0)
+                {
+                    connection.length += received;
+                    decode(id);
+                    continue;
+                }
+                if (received == -1 && errno == EINTR)
+                    continue;
+                if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+
+                // orderly shutdown or a socket error
+                closeConnection(id);
+            }
+        }
+
+        flushResponses();
+    }
+
+    close(epoll_fd);
+}
+
+void Gateway::runIoUring()
+{
+    armAccept();
+    armWake();
+
+    while (running)
+    {
+        // one syscall submits every re-armed receive and waits for completions
+        if (ring->submitAndWait(1) < 0 && errno != EINTR)
+        {
+            throw std::runtime_error("io_uring_enter failed");
+        }
+
+        io_uring_cqe* cqe;
+        while ((cqe = ring->peek()) != nullptr)
+        {
+            uint64_t tag = cqe->user_data & ~0xffffffffull;
+            int result = cqe->res;
+            uint32_t id = cqe->user_data & 0xffffffff;
+            ring->seen();
+
+            if (tag == __LISTEN_TAG__)
+            {
+                if (result >= 0)
+                {
+                    armRecv(openConnection(result));
+                }
+                armAccept();
+                continue;
+            }
+            if (tag == __WAKE_TAG__)
+            {
+                armWake();
+                continue;
+            }
+
+            Connection& connection = connections[id];
+            if (connection.fd == -1)
+                continue;
+            if (result <= 0 && result != -EAGAIN && result != -EINTR)
+            {
+                closeConnection(id);
+                continue;
+            }
+
+            if (result > 0)
+            {
+                connection.length += result;
+                decode(id);
+            }
+            armRecv(id);
+        }
+
+        flushResponses();
+    }
+}
+
+bool Gateway::submitStaged()
+{
+    // a full submission queue drains once the kernel has consumed it
+    return ring->submitAndWait(0) >= 0;
+}
+
+void Gateway::armAccept()
+{
+    if (ring->prepAccept(listen_fd, __LISTEN_TAG__)
+        || (submitStaged() && ring->prepAccept(listen_fd, __LISTEN_TAG__)))
+    {
+        return;
+    }
+    std::cerr << "gateway: io_uring submission queue full, cannot re-arm accept \n";
+    throw std::runtime_error("io_uring submission queue full");
+}
+
+void Gateway::armWake()
+{
+    if (ring->prepRead(wake_fd, &wake_value, sizeof(wake_value), __WAKE_TAG__)
+        || (submitStaged() && ring->prepRead(wake_fd, &wake_value, sizeof(wake_value), __WAKE_TAG__)))
+    {
+        return;
+    }
+    std::cerr << "gateway: io_uring submission queue full, cannot re-arm wake-up \n";
+    throw std::runtime_error("io_uring submission queue full");
+}
+
+void Gateway::armRecv(uint32_t id)
+{
+    Connection& connection = connections[id];
+    char* buffer = connection.buffer.get() + connection.length;
+    unsigned length = __GATEWAY_BUFFER_SIZE__ - connection.length;
+    uint64_t tag = __CONNECTION_TAG__ | id;
+    if (ring->prepRecv(connection.fd, buffer, length, tag)
+        || (submitStaged() && ring->prepRecv(connection.fd, buffer, length, tag)))
+    {
+        return;
+    }
+
+    // never leave a connection without a receive: it would hang for good
+    std::cerr << "gateway: io_uring submission queue full, closing connection " << id << " \n";
+    closeConnection(id);
+}
+
+void Gateway::handle(const GatewayRequest& request)
+{
+    traceBegin(request.received_at);
+    const OrderMessage& message = request.message;
+    AckMessage ack{MessageType::Ack, RejectReason::None, 0, 0, message.client_id, 0, message.sent_at};
+
+    if (message.type != MessageType::NewOrder)
+    {
+        ack.type = MessageType::Reject;
+        ack.reason = RejectReason::UnknownType;
+    }
+    // levels are keyed by 32-bit prices, a wider one would alias a lower level
+    else if (message.quantity == 0 || message.price == 0 || message.price > UINT32_MAX)
+    {
+        ack.type = MessageType::Reject;
+        ack.reason = RejectReason::InvalidOrder;
+    }
+    else {
+        Order order = orderbook.createLevelOrder(message.is_bid, message.quantity, 0, message.price);
+        orderbook.addOrder(order);
+        ack.order_id = order.id();
+        ack.filled_quantity = order.filled_quantity();
+    }
+
+    GatewayResponse response{request.connection, ack};
+    while (!outbound.push(response))
+    {
+        std::this_thread::yield();
+    }
+    tracePoint(TraceStage::Ack);
+    traceEnd();
+    _messages.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Gateway::matchLoop()
+{
+    while (running)
+    {
+        GatewayRequest request;
+        size_t handled = 0;
+        while (handled < __GATEWAY_MATCH_BATCH__ && inbound.pop(request))
+        {
+            handle(request);
+            handled++;
+        }
+
+        if (handled == 0)
+        {
+            // quiet period: give memory back a step at a time
+            if (!orderbook.compact())
+                std::this_thread::yield();
+            continue;
+        }
+
+        // wake the network thread once per batch of acks
+        uint64_t value = 1;
+        write(wake_fd, &value, sizeof(value));
+    }
+}
@@ -0,0 +1,111 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "orderbook.h"
+#include "protocol.h"
+#include "spsc_queue.h"
+#include "io_uring.h"
+#include "trace.h"
+
+
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+const size_t __GATEWAY_QUEUE_SIZE__{4096};
+const size_t __GATEWAY_BUFFER_SIZE__{64 * 1024};
+const size_t __GATEWAY_MATCH_BATCH__{256};
+
+struct GatewayRequest {
+    uint32_t connection;
+    OrderMessage message;
+    // trace receive stamp, 0 while tracing is off
+    uint64_t received_at;
+};
+
+struct GatewayResponse {
+    uint32_t connection;
+    AckMessage message;
+};
+
+/*
+* Loopback TCP order-entry gateway in front of a single OrderBook.
+*
+* The network thread receives in batches (io_uring, or epoll when io_uring is
+* unavailable), decodes fixed-length messages in place from each connection's
+* receive buffer and pushes them onto an inbound queue. A matching thread owns
+* the book, drains the inbound queue and queues acks which the network thread
+* writes back with one send per connection per batch. While the inbound queue
+* is empty the matching thread runs OrderBook::compact() steps.
+*/
+class Gateway {
+public:
+    Gateway(OrderBook& orderbook, uint16_t port=0, bool use_io_uring=true);
+
+    Gateway(const Gateway& g) = delete;
+    Gateway& operator=(const Gateway& g) = delete;
+
+    ~Gateway();
+
+    /*
+     * Runs the network loop on the calling thread until stop() is called.
+     * Errors from the loop are rethrown once the matching thread has exited.
+     */
+    void run();
+    void stop();
+
+    uint16_t port() const { return _port; };
+    bool using_io_uring() const { return ring != nullptr; };
+    uint64_t messages() const { return _messages.load(std::memory_order_relaxed); };
+
+private:
+    struct Connection {
+        int fd{-1};
+        size_t length{0};
+        std::unique_ptr<char[]> buffer;
+        std::vector<AckMessage> pending;
+    };
+
+    OrderBook& orderbook;
+    uint16_t _port;
+    int listen_fd{-1};
+    int wake_fd{-1};
+    uint64_t wake_value{0};
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> _messages{0};
+
+    std::unique_ptr<IoUring> ring;
+    std::vector<Connection> connections;
+    std::vector<uint32_t> dirty;
+
+    SPSCQueue<GatewayRequest, __GATEWAY_QUEUE_SIZE__> inbound;
+    SPSCQueue<GatewayResponse, __GATEWAY_QUEUE_SIZE__> outbound;
+
+    void runEpoll();
+    void runIoUring();
+    void matchLoop();
+
+    /*
+     * Stage the io_uring re-arms. A full submission queue is submitted and
+     * the entry staged again; a receive that still does not fit closes its
+     * connection, an accept or wake-up read that does not fit throws.
+     */
+    bool submitStaged();
+    void armAccept();
+    void armWake();
+    void armRecv(uint32_t id);
+
+    uint32_t openConnection(int fd);
+    void closeConnection(uint32_t id);
+
+    /* Queues every complete message in the receive buffer for matching */
+    void decode(uint32_t id);
+    void handle(const GatewayRequest& request);
+
+    /* Moves queued acks to their connections and sends them in one batch */
+    void flushResponses();
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "orderbook.h"
+#include "gateway.h"
+
+
+Gateway* __GATEWAY__{nullptr};
+
+void handleSignal(int)
+{
+    if (__GATEWAY__ != nullptr)
+        __GATEWAY__->stop();
+}
+
+/*
+* Usage: gateway [port] [tick_size] [--epoll] [--trace <file>] [--memory-budget <bytes>]
+*
+* Serves a single OrderBook on the loopback interface until interrupted.
+* --trace enables per-message latency tracing and appends a text dump of the
+* stage histograms to file every second. --memory-budget lets the matching
+* thread compact the book whenever it is idle and the book is over budget.
+*/
+int main(int argc, const char* argv[])
+{
+    uint16_t port = 9000;
+    uint tick_size = 2;
+    bool use_io_uring = true;
+    std::unique_ptr<TraceAggregator> tracer;
+    size_t memory_budget = 0;
+
+    int position = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--epoll") == 0)
+        {
+            use_io_uring = false;
+            continue;
+        }
+        if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            tracer = std::make_unique<TraceAggregator>(argv[++i]);
+            setTracing(true);
+            continue;
+        }
+        if (std::strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc)
+        {
+            memory_budget = std::strtoull(argv[++i], nullptr, 10);
+            continue;
+        }
+
+        if (position == 0)
+            port = std::atoi(argv[i]);
+        else if (position == 1)
+            tick_size = std::atoi(argv[i]);
+        position++;
+    }
+
+    OrderBook orderbook{tick_size};
+    orderbook.setMemoryBudget(memory_budget);
+    Gateway gateway{orderbook, port, use_io_uring};
+    __GATEWAY__ = &gateway;
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    std::cout << "Gateway listening on 127.0.0.1:" << gateway.port()
+        << " using " << (gateway.using_io_uring() ? "io_uring" : "epoll") << "\n";
+    gateway.run();
+    std::cout << "Handled " << gateway.messages() << " messages \n";
+
+    return 0;
+}
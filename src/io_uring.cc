@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "io_uring.h"
+
+
+IoUring::IoUring(unsigned entries)
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+    {
+        throw std::runtime_error("io_uring is not available");
+    }
+
+    this->entries = params.sq_entries;
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+    {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to map io_uring submission ring");
+    }
+
+    cq_ring = sq_ring;
+    if (!single_mmap)
+    {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED)
+        {
+            munmap(sq_ring, sq_ring_size);
+            close(fd);
+            throw std::runtime_error("Unable to map io_uring completion ring");
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes_addr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_addr == MAP_FAILED)
+    {
+        if (!single_mmap)
+            munmap(cq_ring, cq_ring_size);
+        munmap(sq_ring, sq_ring_size);
+        close(fd);
+        throw std::runtime_error("Unable to map io_uring submission entries");
+    }
+    sqes = static_cast<io_uring_sqe*>(sqes_addr);
+
+    char* sq = static_cast<char*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqe_tail = *sq_tail;
+
+    char* cq = static_cast<char*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring()
+{
+    munmap(sqes, sqes_size);
+    if (cq_ring != sq_ring)
+        munmap(cq_ring, cq_ring_size);
+    munmap(sq_ring, sq_ring_size);
+    close(fd);
+}
+
+io_uring_sqe* IoUring::getSqe()
+{
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sqe_tail - head >= entries)
+    {
+        return nullptr;
+    }
+
+    io_uring_sqe* sqe = &sqes[sqe_tail & *sq_mask];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe_tail++;
+    return sqe;
+}
+
+bool IoUring::prepAccept(int fd, uint64_t user_data)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUring::prepRecv(int fd, void* buffer, unsigned length, uint64_t user_data)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->user_data = user_data;
+    return true;
+}
+
+bool IoUring::prepRead(int fd, void* buffer, unsigned length, uint64_t user_data)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = length;
+    sqe->user_data = user_data;
+    return true;
+}
+
+int IoUring::submitAndWait(unsigned wait_nr)
+{
+    // publish every staged entry in the submission array before the tail
+    unsigned tail = *sq_tail;
+    unsigned to_submit = sqe_tail - tail;
+    for (unsigned i = tail; i != sqe_tail; i++)
+    {
+        sq_array[i & *sq_mask] = i & *sq_mask;
+    }
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    return syscall(__NR_io_uring_enter, fd, to_submit, wait_nr, flags, nullptr, 0);
+}
+
+io_uring_cqe* IoUring::peek()
+{
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+    {
+        return nullptr;
+    }
+    return &cqes[head & *cq_mask];
+}
+
+void IoUring::seen()
+{
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <linux/io_uring.h>
+
+
+#ifndef IO_URING_H
+#define IO_URING_H
+
+/*
+* Minimal io_uring wrapper built directly on the kernel syscalls so the engine
+* does not depend on liburing.
+*
+* Submission entries are staged with getSqe()/prep*() and handed to the kernel
+* in one io_uring_enter call by submitAndWait(), which lets the caller batch an
+* entire loop iteration of receives into a single syscall.
+*/
+class IoUring {
+public:
+    /* Throws std::runtime_error if io_uring is unavailable on this kernel */
+    IoUring(unsigned entries);
+
+    IoUring(const IoUring& r) = delete;
+    IoUring& operator=(const IoUring& r) = delete;
+
+    ~IoUring();
+
+    bool prepAccept(int fd, uint64_t user_data);
+    bool prepRecv(int fd, void* buffer, unsigned length, uint64_t user_data);
+    bool prepRead(int fd, void* buffer, unsigned length, uint64_t user_data);
+
+    /* Submits staged entries and waits for at least wait_nr completions */
+    int submitAndWait(unsigned wait_nr);
+
+    /* Returns the next completion or nullptr; call seen() once handled */
+    io_uring_cqe* peek();
+    void seen();
+
+private:
+    int fd{-1};
+    unsigned entries;
+
+    void* sq_ring{nullptr};
+    void* cq_ring{nullptr};
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    io_uring_sqe* sqes{nullptr};
+    size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned sqe_tail{0};
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    io_uring_sqe* getSqe();
+};
+
+#endif
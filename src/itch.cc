@@ -0,0 +1,258 @@
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "itch.h"
+
+
+// body lengths of the applied message types, including the type byte
+const size_t __ITCH_DIRECTORY_LENGTH__{39};
+const size_t __ITCH_ADD_LENGTH__{36};
+const size_t __ITCH_ADD_MPID_LENGTH__{40};
+const size_t __ITCH_EXECUTED_LENGTH__{31};
+const size_t __ITCH_EXECUTED_PRICE_LENGTH__{36};
+const size_t __ITCH_CANCEL_LENGTH__{23};
+const size_t __ITCH_DELETE_LENGTH__{19};
+const size_t __ITCH_REPLACE_LENGTH__{35};
+
+// every message starts type (1), stock locate (2), tracking number (2), timestamp (6)
+const size_t __ITCH_HEADER_LENGTH__{11};
+
+static uint16_t readBig16(const uint8_t* p)
+{
+    return (uint16_t(p[0]) << 8) | p[1];
+}
+
+static uint32_t readBig32(const uint8_t* p)
+{
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __builtin_bswap32(value);
+}
+
+static uint64_t readBig48(const uint8_t* p)
+{
+    return (uint64_t(readBig16(p)) << 32) | readBig32(p + 2);
+}
+
+static uint64_t readBig64(const uint8_t* p)
+{
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return __builtin_bswap64(value);
+}
+
+static void writeBig(std::vector<uint8_t>& out, uint64_t value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        out.push_back((value >> (i * 8)) & 0xff);
+    }
+}
+
+static size_t bodyLength(ItchMessageType type)
+{
+    switch (type)
+    {
+        case ItchMessageType::StockDirectory: return __ITCH_DIRECTORY_LENGTH__;
+        case ItchMessageType::AddOrder: return __ITCH_ADD_LENGTH__;
+        case ItchMessageType::AddOrderMPID: return __ITCH_ADD_MPID_LENGTH__;
+        case ItchMessageType::OrderExecuted: return __ITCH_EXECUTED_LENGTH__;
+        case ItchMessageType::OrderExecutedWithPrice: return __ITCH_EXECUTED_PRICE_LENGTH__;
+        case ItchMessageType::OrderCancel: return __ITCH_CANCEL_LENGTH__;
+        case ItchMessageType::OrderDelete: return __ITCH_DELETE_LENGTH__;
+        case ItchMessageType::OrderReplace: return __ITCH_REPLACE_LENGTH__;
+    }
+    return 0;
+}
+
+bool decodeItchMessage(const uint8_t* data, size_t length, ItchMessage& message)
+{
+    if (length == 0)
+    {
+        return false;
+    }
+
+    ItchMessageType type = static_cast<ItchMessageType>(data[0]);
+    size_t expected = bodyLength(type);
+    if (expected == 0)
+    {
+        return false;
+    }
+    if (length < expected)
+    {
+        throw std::runtime_error("Truncated ITCH message of type " + std::string(1, data[0]));
+    }
+
+    std::memset(&message, 0, sizeof(message));
+    message.type = type;
+    message.stock_locate = readBig16(data + 1);
+    message.timestamp = readBig48(data + 5);
+
+    const uint8_t* body = data + __ITCH_HEADER_LENGTH__;
+    switch (type)
+    {
+        case ItchMessageType::StockDirectory:
+            std::memcpy(message.symbol, body, __ITCH_SYMBOL_LENGTH__);
+            break;
+        case ItchMessageType::AddOrder:
+        case ItchMessageType::AddOrderMPID:
+            message.order_ref = readBig64(body);
+            message.is_bid = body[8] == 'B';
+            message.shares = readBig32(body + 9);
+            std::memcpy(message.symbol, body + 13, __ITCH_SYMBOL_LENGTH__);
+            message.price = readBig32(body + 21);
+            break;
+        case ItchMessageType::OrderExecuted:
+            message.order_ref = readBig64(body);
+            message.shares = readBig32(body + 8);
+            break;
+        case ItchMessageType::OrderExecutedWithPrice:
+            message.order_ref = readBig64(body);
+            message.shares = readBig32(body + 8);
+            message.price = readBig32(body + 21);
+            break;
+        case ItchMessageType::OrderCancel:
+            message.order_ref = readBig64(body);
+            message.shares = readBig32(body + 8);
+            break;
+        case ItchMessageType::OrderDelete:
+            message.order_ref = readBig64(body);
+            break;
+        case ItchMessageType::OrderReplace:
+            message.order_ref = readBig64(body);
+            message.new_order_ref = readBig64(body + 8);
+            message.shares = readBig32(body + 16);
+            message.price = readBig32(body + 20);
+            break;
+    }
+    return true;
+}
+
+void encodeItchMessage(const ItchMessage& message, std::vector<uint8_t>& out)
+{
+    size_t length = bodyLength(message.type);
+    if (length == 0)
+    {
+        throw std::invalid_argument("Unsupported ITCH message type.");
+    }
+
+    size_t start = out.size();
+    writeBig(out, length, 2);
+    out.push_back(static_cast<uint8_t>(message.type));
+    writeBig(out, message.stock_locate, 2);
+    writeBig(out, 0, 2);
+    writeBig(out, message.timestamp, 6);
+
+    switch (message.type)
+    {
+        case ItchMessageType::StockDirectory:
+            out.insert(out.end(), message.symbol, message.symbol + __ITCH_SYMBOL_LENGTH__);
+            break;
+        case ItchMessageType::AddOrder:
+        case ItchMessageType::AddOrderMPID:
+            writeBig(out, message.order_ref, 8);
+            out.push_back(message.is_bid ? 'B' : 'S');
+            writeBig(out, message.shares, 4);
+            out.insert(out.end(), message.symbol, message.symbol + __ITCH_SYMBOL_LENGTH__);
+            writeBig(out, message.price, 4);
+            break;
+        case ItchMessageType::OrderExecuted:
+        case ItchMessageType::OrderExecutedWithPrice:
+            writeBig(out, message.order_ref, 8);
+            writeBig(out, message.shares, 4);
+            writeBig(out, 0, 8);
+            if (message.type == ItchMessageType::OrderExecutedWithPrice)
+            {
+                out.push_back('Y');
+                writeBig(out, message.price, 4);
+            }
+            break;
+        case ItchMessageType::OrderCancel:
+            writeBig(out, message.order_ref, 8);
+            writeBig(out, message.shares, 4);
+            break;
+        case ItchMessageType::OrderDelete:
+            writeBig(out, message.order_ref, 8);
+            break;
+        case ItchMessageType::OrderReplace:
+            writeBig(out, message.order_ref, 8);
+            writeBig(out, message.new_order_ref, 8);
+            writeBig(out, message.shares, 4);
+            writeBig(out, message.price, 4);
+            break;
+    }
+
+    // zero the fields this encoder does not carry (attribution, directory details)
+    out.resize(start + 2 + length, 0);
+}
+
+std::string itchSymbol(const ItchMessage& message)
+{
+    std::string symbol{message.symbol, __ITCH_SYMBOL_LENGTH__};
+    size_t end = symbol.find_last_not_of(' ');
+    return end == std::string::npos ? "" : symbol.substr(0, end + 1);
+}
+
+bool nextItchMessage(const uint8_t* data, size_t size, size_t& offset, const uint8_t*& body, uint16_t& length)
+{
+    if (offset + 2 > size)
+    {
+        return false;
+    }
+
+    length = readBig16(data + offset);
+    if (offset + 2 + length > size)
+    {
+        throw std::runtime_error("ITCH file ends inside a message.");
+    }
+
+    body = data + offset + 2;
+    offset += 2 + length;
+    return true;
+}
+
+ItchFile::ItchFile(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Unable to open ITCH file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to stat ITCH file: " + path);
+    }
+
+    _size = st.st_size;
+    if (_size == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    void* addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map ITCH file: " + path);
+    }
+
+    // the decoder reads the file front to back exactly once
+    madvise(addr, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const uint8_t*>(addr);
+}
+
+ItchFile::~ItchFile()
+{
+    if (_data != nullptr)
+    {
+        munmap(const_cast<uint8_t*>(_data), _size);
+    }
+}
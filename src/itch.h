@@ -0,0 +1,78 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+#ifndef ITCH_H
+#define ITCH_H
+
+const size_t __ITCH_SYMBOL_LENGTH__{8};
+
+/* ITCH 5.0 message types the replay engine applies; others are skipped */
+enum class ItchMessageType : char {
+    StockDirectory = 'R',
+    AddOrder = 'A',
+    AddOrderMPID = 'F',
+    OrderExecuted = 'E',
+    OrderExecutedWithPrice = 'C',
+    OrderCancel = 'X',
+    OrderDelete = 'D',
+    OrderReplace = 'U',
+};
+
+/*
+* Decoded form of the ITCH messages that change a book. Fields a type does not
+* carry are left zero: shares is the added, executed or cancelled quantity and
+* new_order_ref is only set by replaces. Prices keep ITCH's 4 implied decimals.
+*/
+struct ItchMessage {
+    uint64_t timestamp;
+    uint64_t order_ref;
+    uint64_t new_order_ref;
+    uint32_t shares;
+    uint32_t price;
+    uint16_t stock_locate;
+    ItchMessageType type;
+    bool is_bid;
+    char symbol[__ITCH_SYMBOL_LENGTH__];
+};
+
+/*
+* Decodes a message body (without its length prefix) in a single pass.
+* Returns false for message types that do not change a book and throws
+* std::runtime_error when a known type is truncated.
+*/
+bool decodeItchMessage(const uint8_t* data, size_t length, ItchMessage& message);
+
+/* Appends message to out in ITCH 5.0 binary file framing (2-byte length prefix) */
+void encodeItchMessage(const ItchMessage& message, std::vector<uint8_t>& out);
+
+/* Symbol with its space padding removed */
+std::string itchSymbol(const ItchMessage& message);
+
+/*
+* Read-only memory map of an ITCH binary file. Messages are framed by a
+* big-endian 2-byte length; next() walks them without copying.
+*/
+class ItchFile {
+public:
+    ItchFile(const std::string& path);
+
+    ItchFile(const ItchFile& f) = delete;
+    ItchFile& operator=(const ItchFile& f) = delete;
+
+    ~ItchFile();
+
+    const uint8_t* data() const { return _data; };
+    size_t size() const { return _size; };
+
+private:
+    const uint8_t* _data{nullptr};
+    size_t _size{0};
+};
+
+/* Advances offset past the next framed message. Returns false at the end. */
+bool nextItchMessage(const uint8_t* data, size_t size, size_t& offset, const uint8_t*& body, uint16_t& length);
+
+#endif
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LADDER_X86 1
+#endif
+
+#include "ladder.h"
+
+
+/* Kernel in use, detected on first use so static initialisers elsewhere never see it unset */
+static LadderKernel& selectedKernel()
+{
+    static LadderKernel kernel = detectLadderKernel();
+    return kernel;
+}
+
+LadderKernel detectLadderKernel()
+{
+#ifdef LADDER_X86
+    // needed before static initialisation has run
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return LadderKernel::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return LadderKernel::SSE;
+#endif
+    return LadderKernel::Scalar;
+}
+
+bool ladderKernelSupported(LadderKernel kernel)
+{
+#ifdef LADDER_X86
+    __builtin_cpu_init();
+#endif
+    switch (kernel)
+    {
+#ifdef LADDER_X86
+    case LadderKernel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case LadderKernel::SSE:
+        return __builtin_cpu_supports("sse2");
+#endif
+    case LadderKernel::Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void setLadderKernel(LadderKernel kernel)
+{
+    if (!ladderKernelSupported(kernel))
+    {
+        throw std::invalid_argument("Ladder kernel not supported by this CPU.");
+    }
+    selectedKernel() = kernel;
+}
+
+LadderKernel ladderKernel()
+{
+    return selectedKernel();
+}
+
+
+static size_t findLevelScalar(const uint64_t* volumes, size_t from, size_t count)
+{
+    while (from < count && volumes[from] == 0)
+    {
+        from++;
+    }
+    return from;
+}
+
+static uint64_t sumLevelsScalar(const uint64_t* volumes, size_t from, size_t count, size_t levels)
+{
+    uint64_t total = 0;
+    for (size_t i = from; i < count && levels > 0; i++)
+    {
+        if (volumes[i] != 0)
+        {
+            total += volumes[i];
+            levels--;
+        }
+    }
+    return total;
+}
+
+#ifdef LADDER_X86
+
+/* Bit per 64-bit lane that is non-zero; SSE2 has no 64-bit compare */
+__attribute__((target("sse2")))
+static int nonZeroLanes128(__m128i v)
+{
+    __m128i zero32 = _mm_cmpeq_epi32(v, _mm_setzero_si128());
+    __m128i zero64 = _mm_and_si128(zero32, _mm_shuffle_epi32(zero32, _MM_SHUFFLE(2, 3, 0, 1)));
+    return ~_mm_movemask_pd(_mm_castsi128_pd(zero64)) & 0x3;
+}
+
+__attribute__((target("sse2")))
+static size_t findLevelSSE(const uint64_t* volumes, size_t from, size_t count)
+{
+    // four levels per step, the exact one is picked out of the hit
+    for (; from + 4 <= count; from += 4)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(volumes + from));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(volumes + from + 2));
+        if (nonZeroLanes128(_mm_or_si128(a, b)) != 0)
+            break;
+    }
+    return findLevelScalar(volumes, from, count);
+}
+
+__attribute__((target("sse2")))
+static uint64_t sumLevelsSSE(const uint64_t* volumes, size_t from, size_t count, size_t levels)
+{
+    __m128i total = _mm_setzero_si128();
+    for (; from + 2 <= count; from += 2)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(volumes + from));
+        size_t found = __builtin_popcount(nonZeroLanes128(v));
+        if (found >= levels)
+            break;
+        total = _mm_add_epi64(total, v);
+        levels -= found;
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), total);
+    return lanes[0] + lanes[1] + sumLevelsScalar(volumes, from, count, levels);
+}
+
+__attribute__((target("avx2")))
+static size_t findLevelAVX2(const uint64_t* volumes, size_t from, size_t count)
+{
+    for (; from + 8 <= count; from += 8)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(volumes + from));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(volumes + from + 4));
+        __m256i any = _mm256_or_si256(a, b);
+        if (!_mm256_testz_si256(any, any))
+            break;
+    }
+    return findLevelScalar(volumes, from, count);
+}
+
+__attribute__((target("avx2")))
+static uint64_t sumLevelsAVX2(const uint64_t* volumes, size_t from, size_t count, size_t levels)
+{
+    __m256i total = _mm256_setzero_si256();
+    for (; from + 4 <= count; from += 4)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(volumes + from));
+        int zero = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, _mm256_setzero_si256())));
+        size_t found = 4 - __builtin_popcount(zero);
+        if (found >= levels)
+            break;
+        total = _mm256_add_epi64(total, v);
+        levels -= found;
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumLevelsScalar(volumes, from, count, levels);
+}
+
+#endif
+
+size_t ladderFindLevel(const uint64_t* volumes, size_t from, size_t count)
+{
+#ifdef LADDER_X86
+    LadderKernel kernel = selectedKernel();
+    if (kernel == LadderKernel::AVX2)
+        return findLevelAVX2(volumes, from, count);
+    if (kernel == LadderKernel::SSE)
+        return findLevelSSE(volumes, from, count);
+#endif
+    return findLevelScalar(volumes, from, count);
+}
+
+uint64_t ladderSumLevels(const uint64_t* volumes, size_t from, size_t count, size_t levels)
+{
+    if (levels == 0)
+    {
+        return 0;
+    }
+#ifdef LADDER_X86
+    LadderKernel kernel = selectedKernel();
+    if (kernel == LadderKernel::AVX2)
+        return sumLevelsAVX2(volumes, from, count, levels);
+    if (kernel == LadderKernel::SSE)
+        return sumLevelsSSE(volumes, from, count, levels);
+#endif
+    return sumLevelsScalar(volumes, from, count, levels);
+}
+
+
+LadderBook::LadderBook(uint64_t low, uint64_t high)
+    :_low{low},
+    _high{high}
+{
+    if (low > high)
+    {
+        throw std::invalid_argument("Ladder range must have low <= high.");
+    }
+    count = high - low + 1;
+    for (Side* side : {&bids, &asks})
+    {
+        side->volumes.assign(count + 1, 0);
+        side->order_counts.assign(count + 1, 0);
+        side->best = count;
+    }
+}
+
+size_t LadderBook::index(bool is_bid, uint64_t price) const
+{
+    if (price < _low || price > _high)
+    {
+        throw std::out_of_range("Price outside of the ladder range.");
+    }
+    return is_bid ? _high - price : price - _low;
+}
+
+void LadderBook::applyLevel(bool is_bid, uint64_t price, uint64_t volume, uint32_t order_count)
+{
+    Side& side = is_bid ? bids : asks;
+    size_t i = index(is_bid, price);
+
+    bool existed = side.volumes[i] != 0;
+    side.volumes[i] = volume;
+    side.order_counts[i] = volume == 0 ? 0 : order_count;
+    side.levels += (volume != 0) - existed;
+
+    if (volume != 0 && i < side.best)
+    {
+        side.best = i;
+    }
+    else if (volume == 0 && i == side.best) {
+        // skip the emptied run without visiting each level
+        side.best = ladderFindLevel(side.volumes.data(), i + 1, count);
+    }
+}
+
+void LadderBook::apply(const MarketDataEvent& event)
+{
+    if (event.type == MarketDataEventType::Depth)
+    {
+        applyLevel(event.is_bid, event.price, event.quantity, event.order_count);
+    }
+}
+
+void LadderBook::apply(const MarketDataSnapshot& snapshot)
+{
+    clear();
+    for (uint32_t i = 0; i < snapshot.bid_count; i++)
+    {
+        const MarketDataLevel& level = snapshot.bids[i];
+        applyLevel(true, level.price, level.volume, level.order_count);
+    }
+    for (uint32_t i = 0; i < snapshot.ask_count; i++)
+    {
+        const MarketDataLevel& level = snapshot.asks[i];
+        applyLevel(false, level.price, level.volume, level.order_count);
+    }
+}
+
+void LadderBook::clear()
+{
+    for (Side* side : {&bids, &asks})
+    {
+        std::fill(side->volumes.begin(), side->volumes.end(), 0);
+        std::fill(side->order_counts.begin(), side->order_counts.end(), 0);
+        side->best = count;
+        side->levels = 0;
+    }
+}
+
+uint64_t LadderBook::volume(bool is_bid, uint64_t price) const
+{
+    const Side& side = is_bid ? bids : asks;
+    return side.volumes[index(is_bid, price)];
+}
+
+uint32_t LadderBook::order_count(bool is_bid, uint64_t price) const
+{
+    const Side& side = is_bid ? bids : asks;
+    return side.order_counts[index(is_bid, price)];
+}
+
+uint64_t LadderBook::inside_bid_price() const
+{
+    return bids.best == count ? 0 : _high - bids.best;
+}
+
+uint64_t LadderBook::inside_ask_price() const
+{
+    return asks.best == count ? 0 : _low + asks.best;
+}
+
+uint64_t LadderBook::depthVolume(bool is_bid, size_t levels) const
+{
+    const Side& side = is_bid ? bids : asks;
+    return ladderSumLevels(side.volumes.data(), side.best, count, levels);
+}
@@ -0,0 +1,101 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "market_data.h"
+
+
+#ifndef LADDER_H
+#define LADDER_H
+
+/* Implementations of the ladder scans, fastest first */
+enum class LadderKernel {
+    AVX2,
+    SSE,
+    Scalar,
+};
+
+/* Fastest kernel the CPU supports; the default is detected on first use */
+LadderKernel detectLadderKernel();
+bool ladderKernelSupported(LadderKernel kernel);
+
+/*
+* Selects the kernel used by every ladder from now on; defaults to
+* detectLadderKernel(). Throws std::invalid_argument if the CPU lacks it.
+*/
+void setLadderKernel(LadderKernel kernel);
+LadderKernel ladderKernel();
+
+/* Index of the first non-zero volume in [from, count), or count if none */
+size_t ladderFindLevel(const uint64_t* volumes, size_t from, size_t count);
+
+/*
+* Sums the first `levels` non-zero volumes in [from, count). Whole vectors
+* are summed while they hold fewer non-zero levels than are still wanted.
+*/
+uint64_t ladderSumLevels(const uint64_t* volumes, size_t from, size_t count, size_t levels);
+
+/*
+* Price-level book held in a price-indexed ladder: per side, a contiguous
+* array of level volumes and one of order counts covering a fixed price range.
+*
+* Both sides are indexed from their inside outwards (asks from the lowest
+* price, bids from the highest), so when the best level empties the next one
+* is found by a vectorised forward scan for the first non-zero volume rather
+* than by visiting each empty level. Depth over the top levels uses the same
+* scan. Updates are O(1). Suited to instruments trading in a dense band of
+* ticks; prices outside the range throw std::out_of_range.
+*/
+class LadderBook {
+public:
+    LadderBook(uint64_t low, uint64_t high);
+
+    LadderBook(const LadderBook& b) = delete;
+    LadderBook& operator=(const LadderBook& b) = delete;
+
+    /* Adds or modifies a level, or deletes it when volume is 0 */
+    void applyLevel(bool is_bid, uint64_t price, uint64_t volume, uint32_t order_count);
+    void deleteLevel(bool is_bid, uint64_t price) { applyLevel(is_bid, price, 0, 0); };
+
+    /* Applies depth events; trades and mass cancels carry no level state */
+    void apply(const MarketDataEvent& event);
+
+    /* Replaces the book with the levels of a snapshot */
+    void apply(const MarketDataSnapshot& snapshot);
+
+    void clear();
+
+    uint64_t volume(bool is_bid, uint64_t price) const;
+    uint32_t order_count(bool is_bid, uint64_t price) const;
+
+    uint64_t inside_bid_price() const;
+    uint64_t inside_ask_price() const;
+    uint64_t inside_bid_volume() const { return bids.volumes[bids.best]; };
+    uint64_t inside_ask_volume() const { return asks.volumes[asks.best]; };
+
+    /* Volume of the best `levels` levels of a side */
+    uint64_t depthVolume(bool is_bid, size_t levels) const;
+
+    size_t size(bool is_bid) const { return is_bid ? bids.levels : asks.levels; };
+    uint64_t low() const { return _low; };
+    uint64_t high() const { return _high; };
+
+private:
+    struct Side {
+        // one padding entry past the range keeps volumes[best] valid when empty
+        std::vector<uint64_t> volumes;
+        std::vector<uint32_t> order_counts;
+        size_t best;
+        size_t levels{0};
+    };
+
+    uint64_t _low;
+    uint64_t _high;
+    size_t count;
+    Side bids;
+    Side asks;
+
+    size_t index(bool is_bid, uint64_t price) const;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include "arena.h"
+#include "level_list.h"
+#include "market_data.h"
+
+
+#ifndef LEVEL_BOOK_H
+#define LEVEL_BOOK_H
+
+/*
+* Aggregated level of a market-by-price book: price, total volume and order
+* count with no per-order queue. Accessors mirror Limit so code written against
+* a level reads the same for either book.
+*/
+class PriceLevel {
+public:
+    PriceLevel* next{nullptr};
+    PriceLevel* prev{nullptr};
+
+    PriceLevel(uint64_t price=0)
+        :_price{price} {}
+
+    void update(uint64_t volume, uint32_t order_count)
+    {
+        _total_volume = volume;
+        _size = order_count;
+    }
+
+    uint32_t size() const { return _size; };
+    uint64_t total_volume() const { return _total_volume; };
+    uint64_t price() const { return _price; };
+
+private:
+    uint64_t _price;
+    uint64_t _total_volume{0};
+    uint32_t _size{0};
+};
+
+/*
+* Price-level-only book for market-data consumers.
+*
+* Levels are kept the same way OrderBook keeps limits: a hash map per side for
+* direct access by price plus a sorted linked list from the inside, maintained
+* by the same linkLevel / unlinkLevel (level_list.h). The Level policy must
+* provide next / prev pointers, price(), total_volume(), size() and
+* update(volume, order_count). Updates set the aggregate state of a level; a
+* volume of 0 deletes it, matching the depth events OrderBook publishes.
+*/
+template<typename Level>
+class LevelBook {
+public:
+    typedef std::pair<const uint64_t, Level> LevelEntry;
+    typedef std::unordered_map<uint64_t, Level, std::hash<uint64_t>, std::equal_to<uint64_t>, ArenaAllocator<LevelEntry>> LevelMap;
+
+    /* When an arena is given, levels are allocated from it. It must outlive the book. */
+    LevelBook(Arena* arena=nullptr)
+        :bid_levels(0, std::hash<uint64_t>{}, std::equal_to<uint64_t>{}, ArenaAllocator<LevelEntry>{arena}),
+        ask_levels(0, std::hash<uint64_t>{}, std::equal_to<uint64_t>{}, ArenaAllocator<LevelEntry>{arena})
+    {}
+
+    LevelBook(const LevelBook& b) = delete;
+    LevelBook& operator=(const LevelBook& b) = delete;
+
+    /* Adds or modifies a level, or deletes it when volume is 0 */
+    void applyLevel(bool is_bid, uint64_t price, uint64_t volume, uint32_t order_count)
+    {
+        if (volume == 0)
+        {
+            deleteLevel(is_bid, price);
+            return;
+        }
+
+        LevelMap& levels = is_bid ? bid_levels : ask_levels;
+        auto [it, added] = levels.try_emplace(price, price);
+        it->second.update(volume, order_count);
+        if (added)
+        {
+            linkLevel(is_bid ? best_bid : best_ask, it->second, is_bid);
+        }
+    }
+
+    void deleteLevel(bool is_bid, uint64_t price)
+    {
+        LevelMap& levels = is_bid ? bid_levels : ask_levels;
+        auto it = levels.find(price);
+        if (it == levels.end())
+        {
+            return;
+        }
+
+        unlinkLevel(is_bid ? best_bid : best_ask, it->second);
+        levels.erase(it);
+    }
+
+    /* Applies depth events; trades and mass cancels carry no level state */
+    void apply(const MarketDataEvent& event)
+    {
+        if (event.type == MarketDataEventType::Depth)
+        {
+            applyLevel(event.is_bid, event.price, event.quantity, event.order_count);
+        }
+    }
+
+    /* Replaces the book with the levels of a snapshot */
+    void apply(const MarketDataSnapshot& snapshot)
+    {
+        clear();
+        for (uint32_t i = 0; i < snapshot.bid_count; i++)
+        {
+            const MarketDataLevel& level = snapshot.bids[i];
+            applyLevel(true, level.price, level.volume, level.order_count);
+        }
+        for (uint32_t i = 0; i < snapshot.ask_count; i++)
+        {
+            const MarketDataLevel& level = snapshot.asks[i];
+            applyLevel(false, level.price, level.volume, level.order_count);
+        }
+    }
+
+    void clear()
+    {
+        bid_levels.clear();
+        ask_levels.clear();
+        best_bid = nullptr;
+        best_ask = nullptr;
+    }
+
+    /* Level at price, or nullptr if there is none */
+    const Level* level(bool is_bid, uint64_t price) const
+    {
+        const LevelMap& levels = is_bid ? bid_levels : ask_levels;
+        auto it = levels.find(price);
+        return it == levels.end() ? nullptr : &it->second;
+    }
+
+    /* Inside level of a side, walk outward with next */
+    const Level* best(bool is_bid) const { return is_bid ? best_bid : best_ask; };
+
+    uint64_t inside_bid_price() const { return best_bid == nullptr ? 0 : best_bid->price(); };
+    uint64_t inside_ask_price() const { return best_ask == nullptr ? 0 : best_ask->price(); };
+    uint64_t inside_bid_volume() const { return best_bid == nullptr ? 0 : best_bid->total_volume(); };
+    uint64_t inside_ask_volume() const { return best_ask == nullptr ? 0 : best_ask->total_volume(); };
+
+    size_t size(bool is_bid) const { return is_bid ? bid_levels.size() : ask_levels.size(); };
+
+private:
+    LevelMap bid_levels;
+    LevelMap ask_levels;
+    Level* best_bid{nullptr};
+    Level* best_ask{nullptr};
+};
+
+/* Market-by-price book of aggregated levels */
+typedef LevelBook<PriceLevel> MBPBook;
+
+#endif
@@ -0,0 +1,56 @@
+#include <cstdint>
+
+
+#ifndef LEVEL_LIST_H
+#define LEVEL_LIST_H
+
+/*
+* Sorted doubly linked list of the levels of one book side, shared by
+* OrderBook's limits and LevelBook's aggregated levels. best is the inside
+* level: the highest bid or the lowest ask. The Level type must provide
+* next / prev pointers and price(); storage stays with the caller's map.
+*/
+
+/* Inserts a new level into its side's list, walking from the inside */
+template<typename Level>
+void linkLevel(Level*& best, Level& level, bool is_bid)
+{
+    auto inside = [is_bid](uint64_t a, uint64_t b) { return is_bid ? a > b : a < b; };
+
+    if (best == nullptr || inside(level.price(), best->price()))
+    {
+        level.next = best;
+        if (best != nullptr)
+            best->prev = &level;
+        best = &level;
+        return;
+    }
+
+    // insert level into correct position within linked list
+    Level* head = best;
+    while (head->next != nullptr && inside(head->next->price(), level.price()))
+    {
+        head = head->next;
+    }
+    level.next = head->next;
+    level.prev = head;
+    if (head->next != nullptr)
+    {
+        head->next->prev = &level;
+    }
+    head->next = &level;
+}
+
+/* Unlinks a level before its caller erases it, moving best on if needed */
+template<typename Level>
+void unlinkLevel(Level*& best, Level& level)
+{
+    if (level.prev != nullptr)
+        level.prev->next = level.next;
+    else
+        best = level.next;
+    if (level.next != nullptr)
+        level.next->prev = level.prev;
+}
+
+#endif
@@ -1,4 +1,4 @@
-#include <memory>
+#include <algorithm>
 #include <ostream>
 
 #include "limit.h"
@@ -6,125 +6,104 @@
 Limit::Limit(uint64_t price)
     :_price{price}{}
 
-Limit::Limit(const Limit& l)
-    :head_order{l.head_order},
-    tail_order{l.tail_order},
-    next{l.next},
-    _price{l.price()},
-    _total_volume{l.total_volume()},
-    _size{l.size()} {}
-
-Limit& Limit::operator=(const Limit& l)
+void Limit::addOrder(OrderPool& pool, uint32_t order)
 {
-    _price = l.price();
-    _total_volume = l.total_volume();
-    _size = l.size();
-    head_order = l.head_order;
-    tail_order = l.tail_order;
-    next = l.next;
-
-    return *this;
-}
-
-Limit::Limit(Limit&& l)
-    :head_order{l.head_order},
-    tail_order{l.tail_order},
-    next{l.next},
-    _price{l.price()},
-    _total_volume{l.total_volume()},
-    _size{l.size()}
-{
-    l._price = l._total_volume = l._size = 0;
-    l.head_order = nullptr;
-    l.tail_order = nullptr;
-    // BUG: any limits pointing to this one via next will seg-fault.
-    l.next = nullptr;
-}
-
-Limit& Limit::operator=(Limit&& l)
-{
-    if (this != &l)
-    {
-        _price = l.price();
-        _total_volume = l.total_volume();
-        _size = l.size();
-        head_order = l.head_order;
-        tail_order = l.tail_order;
-        next = l.next;
-
-        l._price = l._total_volume = l._size = 0;
-        l.head_order = nullptr;
-        l.tail_order = nullptr;
-        // BUG: any limits pointing to this one via next will seg-fault.
-        l.next = nullptr;
-    }
+    RestingOrder& resting = pool[order];
+    resting.next = __NO_ORDER__;
+    resting.prev = tail_order;
 
-    return *this;
-}
-
-Limit::~Limit()
-{
-    _price = _total_volume = _size = 0;
-    head_order = tail_order = nullptr;
-    next = nullptr;
-}
-
-void Limit::addOrder(std::shared_ptr<Order> order)
-{
     // update head and tail of limit order linked list
-    if (head_order == nullptr)
+    if (head_order == __NO_ORDER__)
     {
         head_order = order;
-        tail_order = order;
     }
     else {
-        // update pointer of existing tail order
-        tail_order->next_order = order;
-        order->prev_order = tail_order;
+        pool[tail_order].next = order;
     }
 
     tail_order = order;
-    _total_volume += order->open_quantity();
+    _visible_volume += resting.open_quantity;
+    if (resting.iceberg)
+        _hidden_volume += pool.info(order).hidden;
     _size++;
     return;
 }
 
-void Limit::removeOrder(std::shared_ptr<Order> order)
+void Limit::removeOrder(OrderPool& pool, uint32_t order)
 {
-    _total_volume -= order->open_quantity();
+    RestingOrder& resting = pool[order];
+    _visible_volume -= resting.open_quantity;
+    if (resting.iceberg)
+        _hidden_volume -= pool.info(order).hidden;
     _size--;
 
-    if (head_order == tail_order)
+    if (resting.next != __NO_ORDER__)
     {
-        head_order = nullptr;
-        tail_order = nullptr;
-        return;
-    }
-
-    if (order->next_order)
-    {
-        order->next_order->prev_order = order->prev_order;
+        pool[resting.next].prev = resting.prev;
     } else {
         // no next order, make previous order the new tail
-        tail_order = order->prev_order;
+        tail_order = resting.prev;
     }
 
-    if (order->prev_order)
+    if (resting.prev != __NO_ORDER__)
     {
-        order->prev_order->next_order = order->next_order;
+        pool[resting.prev].next = resting.next;
     } else {
         // no previous order, make next order the new head
-        head_order = order->next_order;
+        head_order = resting.next;
     }
 
+    resting.next = resting.prev = __NO_ORDER__;
     return;
 }
 
+bool Limit::replenishOrder(OrderPool& pool, uint32_t order, uint64_t created_at)
+{
+    RestingOrder& resting = pool[order];
+    if (!resting.iceberg || pool.info(order).hidden == 0)
+    {
+        return false;
+    }
+
+    RestingOrderInfo& info = pool.info(order);
+    uint32_t tranche = std::min(info.peak, info.hidden);
+    info.hidden -= tranche;
+    info.created_at = created_at;
+    resting.open_quantity = tranche;
+    _hidden_volume -= tranche;
+    _visible_volume += tranche;
+
+    if (order == tail_order)
+    {
+        return true;
+    }
+
+    // unlink and append the same slot: no allocation, index and owner links stay valid
+    if (resting.prev != __NO_ORDER__)
+        pool[resting.prev].next = resting.next;
+    else
+        head_order = resting.next;
+    pool[resting.next].prev = resting.prev;
+
+    resting.prev = tail_order;
+    resting.next = __NO_ORDER__;
+    pool[tail_order].next = order;
+    tail_order = order;
+    return true;
+}
+
+void Limit::reduceReserve(OrderPool& pool, uint32_t order, uint32_t quantity)
+{
+    pool.info(order).hidden -= quantity;
+    _hidden_volume -= quantity;
+}
+
 std::ostream& operator<<(std::ostream& os, const Limit& l)
 {
     return os << "<Limit>{" \
         << "price:" << l.price() << " " \
-        << "total_volume:" << l.total_volume() << " " \
+        << "visible_volume:" << l.visible_volume() << " " \
+        << "hidden_volume:" << l.hidden_volume() << " " \
         << "size:" << l.size()
         << "} \n";
 }
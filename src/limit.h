@@ -1,6 +1,7 @@
-#include <memory>
+#include <cstdint>
+#include <ostream>
 
-#include "order.h"
+#include "order_pool.h"
 
 
 #ifndef LIMIT_H
@@ -9,35 +10,52 @@
 /*
 * A Book level containing a list of orders at a given price-point.
 *
-* Orders are stored using shared pointers because they are referenced in a
-* number of places incl. order map, limit linked lists, etc.
+* Orders live in the book's OrderPool and are queued by 32-bit index, so every
+* method that walks or relinks the queue takes the pool.
 */
 class Limit {
 public:
-    std::shared_ptr<Order> head_order{nullptr};
-    std::shared_ptr<Order> tail_order{nullptr};
+    uint32_t head_order{__NO_ORDER__};
+    uint32_t tail_order{__NO_ORDER__};
     Limit* next{nullptr};
+    Limit* prev{nullptr};
+    // last snapshot epoch the level was preserved in or created during
+    uint32_t snapshot_epoch{0};
 
     Limit(uint64_t price=0);
 
-    Limit(const Limit& l);
-    Limit& operator=(const Limit& l);
+    void addOrder(OrderPool& pool, uint32_t order);
 
-    Limit(Limit&& l);
-    Limit& operator=(Limit&& l);
+    /* Unlinks an order from the queue; the caller releases its slot */
+    void removeOrder(OrderPool& pool, uint32_t order);
 
-    virtual ~Limit();
+    /* Fills a resting order and keeps the limit volume in step */
+    void fillOrder(OrderPool& pool, uint32_t order, uint32_t quantity) { pool[order].open_quantity -= quantity; _visible_volume -= quantity; };
 
-    void removeOrder(std::shared_ptr<Order> order);
-    void addOrder(std::shared_ptr<Order> order);
+    /*
+     * Refills an iceberg whose shown tranche is exhausted from its hidden
+     * reserve and relinks the same slot at the tail with a new timestamp.
+     * Returns false, leaving the order alone, when there is no reserve left.
+     */
+    bool replenishOrder(OrderPool& pool, uint32_t order, uint64_t created_at);
+
+    /* Takes quantity off an iceberg's hidden reserve, keeping its priority */
+    void reduceReserve(OrderPool& pool, uint32_t order, uint32_t quantity);
+
+    /* Moves a peg group's queue; book levels are keyed by price and never move */
+    void reprice(uint64_t price) { _price = price; };
 
     uint size() const { return _size; };
-    uint total_volume() const { return _total_volume; };
+    /* Shown and hidden volume; market data only ever sees the shown volume */
+    uint visible_volume() const { return _visible_volume; };
+    uint hidden_volume() const { return _hidden_volume; };
+    uint total_volume() const { return _visible_volume + _hidden_volume; };
     uint64_t price() const { return _price; };
 
 private:
     uint64_t _price;
-    uint _total_volume{0};
+    uint _visible_volume{0};
+    uint _hidden_volume{0};
     uint _size{0};
 };
 
@@ -0,0 +1,226 @@
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "market_data.h"
+
+
+const uint64_t __MD_MAGIC__{0x4f424d4431000000};
+const int __MD_RESYNC_ATTEMPTS__{64};
+
+static size_t regionLength(uint32_t capacity)
+{
+    return sizeof(MarketDataRegion) + sizeof(MarketDataSlot) * capacity;
+}
+
+MarketDataPublisher::MarketDataPublisher(const std::string& name, uint32_t capacity)
+    :_name{name},
+    _mask{capacity - 1},
+    _length{regionLength(capacity)}
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    {
+        throw std::invalid_argument("Ring capacity must be a power of two.");
+    }
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0600);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Unable to open shared memory: " + name);
+    }
+    if (ftruncate(fd, _length) == -1)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Unable to size shared memory: " + name);
+    }
+
+    void* addr = mmap(nullptr, _length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Unable to map shared memory: " + name);
+    }
+
+    // freshly truncated memory is zeroed so every slot starts unpublished
+    region = static_cast<MarketDataRegion*>(addr);
+    slots = reinterpret_cast<MarketDataSlot*>(region + 1);
+    region->capacity = capacity;
+    std::atomic_thread_fence(std::memory_order_release);
+    region->magic = __MD_MAGIC__;
+}
+
+MarketDataPublisher::~MarketDataPublisher()
+{
+    munmap(region, _length);
+    shm_unlink(_name.c_str());
+}
+
+void MarketDataPublisher::publish(const MarketDataEvent& event)
+{
+    uint64_t sequence = ++_sequence;
+    MarketDataSlot& slot = slots[sequence & _mask];
+
+    // invalidate the slot first so readers never accept a half-written event
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.event, &event, sizeof(MarketDataEvent));
+    slot.event.sequence = sequence;
+    slot.sequence.store(sequence, std::memory_order_release);
+
+    region->write_sequence.store(sequence, std::memory_order_release);
+}
+
+void MarketDataPublisher::publishTrade(uint64_t price, uint64_t quantity, bool is_bid, uint64_t maker_id, uint64_t taker_id)
+{
+    MarketDataEvent event{0, price, quantity, maker_id, taker_id, 0, MarketDataEventType::Trade, is_bid};
+    publish(event);
+}
+
+void MarketDataPublisher::publishDepth(bool is_bid, uint64_t price, uint64_t volume, uint32_t order_count)
+{
+    MarketDataEvent event{0, price, volume, 0, 0, order_count, MarketDataEventType::Depth, is_bid};
+    publish(event);
+}
+
+void MarketDataPublisher::publishMassCancel(uint64_t owner, uint32_t order_count, uint64_t volume)
+{
+    MarketDataEvent event{0, 0, volume, owner, 0, order_count, MarketDataEventType::MassCancel, false};
+    publish(event);
+}
+
+void MarketDataPublisher::beginSnapshot()
+{
+    staged.bid_count = 0;
+    staged.ask_count = 0;
+}
+
+void MarketDataPublisher::addSnapshotLevel(bool is_bid, uint64_t price, uint64_t volume, uint32_t order_count)
+{
+    uint32_t& count = is_bid ? staged.bid_count : staged.ask_count;
+    if (count == __MD_SNAPSHOT_LEVELS__)
+    {
+        return;
+    }
+
+    MarketDataLevel* levels = is_bid ? staged.bids : staged.asks;
+    levels[count++] = MarketDataLevel{price, volume, order_count};
+}
+
+void MarketDataPublisher::endSnapshot()
+{
+    staged.sequence = _sequence;
+
+    // odd version marks the snapshot as being written
+    uint64_t version = region->snapshot_version.load(std::memory_order_relaxed);
+    region->snapshot_version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&region->snapshot, &staged, sizeof(MarketDataSnapshot));
+    region->snapshot_version.store(version + 2, std::memory_order_release);
+}
+
+
+MarketDataReader::MarketDataReader(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Unable to open shared memory: " + name);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(MarketDataRegion))
+    {
+        close(fd);
+        throw std::runtime_error("Shared memory is not a market data ring: " + name);
+    }
+
+    _length = st.st_size;
+    void* addr = mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable to map shared memory: " + name);
+    }
+
+    region = static_cast<MarketDataRegion*>(addr);
+    if (region->magic != __MD_MAGIC__ || regionLength(region->capacity) != _length)
+    {
+        munmap(addr, _length);
+        throw std::runtime_error("Shared memory is not a market data ring: " + name);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    slots = reinterpret_cast<MarketDataSlot*>(region + 1);
+    _mask = region->capacity - 1;
+
+    // start from the live edge of the ring
+    _next_sequence = region->write_sequence.load(std::memory_order_acquire) + 1;
+}
+
+MarketDataReader::~MarketDataReader()
+{
+    munmap(region, _length);
+}
+
+MarketDataReadStatus MarketDataReader::read(MarketDataEvent& event)
+{
+    uint64_t written = region->write_sequence.load(std::memory_order_acquire);
+    if (written < _next_sequence)
+    {
+        return MarketDataReadStatus::Empty;
+    }
+    if (written - _next_sequence > _mask)
+    {
+        return MarketDataReadStatus::Overrun;
+    }
+
+    const MarketDataSlot& slot = slots[_next_sequence & _mask];
+    uint64_t before = slot.sequence.load(std::memory_order_acquire);
+    if (before != _next_sequence)
+    {
+        // slot already published and since invalidated or replaced by a lap
+        return MarketDataReadStatus::Overrun;
+    }
+
+    std::memcpy(&event, &slot.event, sizeof(MarketDataEvent));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != before)
+    {
+        return MarketDataReadStatus::Overrun;
+    }
+
+    _next_sequence++;
+    return MarketDataReadStatus::Ok;
+}
+
+bool MarketDataReader::resync(MarketDataSnapshot& snapshot)
+{
+    for (int i = 0; i < __MD_RESYNC_ATTEMPTS__; i++)
+    {
+        uint64_t before = region->snapshot_version.load(std::memory_order_acquire);
+        if (before == 0)
+        {
+            // publisher has not written a snapshot yet
+            return false;
+        }
+        if (before & 1)
+        {
+            continue;
+        }
+
+        std::memcpy(&snapshot, &region->snapshot, sizeof(MarketDataSnapshot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (region->snapshot_version.load(std::memory_order_relaxed) == before)
+        {
+            _next_sequence = snapshot.sequence + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,160 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+#ifndef MARKET_DATA_H
+#define MARKET_DATA_H
+
+// ring capacity must be a power of two so slots can be found with a mask
+const uint32_t __MD_RING_CAPACITY__{4096};
+const uint32_t __MD_SNAPSHOT_LEVELS__{256};
+
+enum class MarketDataEventType : uint8_t {
+    Trade = 1,
+    Depth = 2,
+    MassCancel = 3,
+};
+
+/*
+* A single book event as published into the ring.
+*
+* Depth events carry the new aggregate state of a level (volume of 0 means the
+* level was removed). Trade events carry the fill price and quantity along
+* with the resting (maker) and incoming (taker) order ids. A mass cancel follows
+* the depth events of the levels it changed and carries the owner (0 for side
+* or price range cancels) in maker_id, the orders removed in order_count and the
+* open quantity removed in quantity.
+*/
+struct MarketDataEvent {
+    uint64_t sequence;
+    uint64_t price;
+    uint64_t quantity;
+    uint64_t maker_id;
+    uint64_t taker_id;
+    uint32_t order_count;
+    MarketDataEventType type;
+    bool is_bid;
+};
+
+struct MarketDataLevel {
+    uint64_t price;
+    uint64_t volume;
+    uint32_t order_count;
+};
+
+/*
+* Point-in-time copy of the book used by readers to resync after an overrun.
+* Replaying ring events from sequence + 1 onwards brings it up to date.
+*/
+struct MarketDataSnapshot {
+    uint64_t sequence;
+    uint32_t bid_count;
+    uint32_t ask_count;
+    MarketDataLevel bids[__MD_SNAPSHOT_LEVELS__];
+    MarketDataLevel asks[__MD_SNAPSHOT_LEVELS__];
+};
+
+/*
+* Layout of the shared-memory region. Slots follow the header directly.
+*
+* Each slot is a seqlock: the writer zeroes the slot sequence, copies the event
+* and then publishes the new sequence. The snapshot uses a version counter
+* which is odd while a snapshot is being written.
+*/
+struct MarketDataRegion {
+    uint64_t magic;
+    uint32_t capacity;
+    alignas(64) std::atomic<uint64_t> write_sequence;
+    alignas(64) std::atomic<uint64_t> snapshot_version;
+    MarketDataSnapshot snapshot;
+};
+
+struct alignas(64) MarketDataSlot {
+    std::atomic<uint64_t> sequence;
+    MarketDataEvent event;
+};
+
+enum class MarketDataReadStatus {
+    Ok,
+    Empty,
+    Overrun,
+};
+
+/*
+* Single-writer publisher of book events into a POSIX shared-memory ring.
+*
+* Publishing is a copy into the next slot and a release store; the writer never
+* waits on readers, so slow readers are overrun rather than blocking matching.
+*/
+class MarketDataPublisher {
+public:
+    MarketDataPublisher(const std::string& name, uint32_t capacity=__MD_RING_CAPACITY__);
+
+    MarketDataPublisher(const MarketDataPublisher& p) = delete;
+    MarketDataPublisher& operator=(const MarketDataPublisher& p) = delete;
+
+    ~MarketDataPublisher();
+
+    void publishTrade(uint64_t price, uint64_t quantity, bool is_bid, uint64_t maker_id, uint64_t taker_id);
+    void publishDepth(bool is_bid, uint64_t price, uint64_t volume, uint32_t order_count);
+    void publishMassCancel(uint64_t owner, uint32_t order_count, uint64_t volume);
+
+    /*
+     * Snapshot levels are staged locally and copied into the shared region in
+     * a single seqlock write by endSnapshot(). Levels past the snapshot limit
+     * are dropped.
+     */
+    void beginSnapshot();
+    void addSnapshotLevel(bool is_bid, uint64_t price, uint64_t volume, uint32_t order_count);
+    void endSnapshot();
+
+    uint64_t sequence() const { return _sequence; };
+    const std::string& name() const { return _name; };
+
+private:
+    std::string _name;
+    uint32_t _mask;
+    uint64_t _sequence{0};
+    size_t _length;
+    MarketDataRegion* region;
+    MarketDataSlot* slots;
+    MarketDataSnapshot staged;
+
+    void publish(const MarketDataEvent& event);
+};
+
+/*
+* Read-only view of a publisher's ring. Any number of readers may attach.
+*
+* Readers track their own next sequence. When the writer has lapped a reader,
+* read() reports an overrun and the reader must resync() from the snapshot.
+*/
+class MarketDataReader {
+public:
+    MarketDataReader(const std::string& name);
+
+    MarketDataReader(const MarketDataReader& r) = delete;
+    MarketDataReader& operator=(const MarketDataReader& r) = delete;
+
+    ~MarketDataReader();
+
+    MarketDataReadStatus read(MarketDataEvent& event);
+
+    /*
+     * Copies the latest snapshot and skips the reader past the events it
+     * already covers. Returns false if no consistent snapshot could be read.
+     */
+    bool resync(MarketDataSnapshot& snapshot);
+
+    uint64_t next_sequence() const { return _next_sequence; };
+
+private:
+    uint32_t _mask;
+    uint64_t _next_sequence{1};
+    size_t _length;
+    MarketDataRegion* region;
+    MarketDataSlot* slots;
+};
+
+#endif
@@ -1,4 +1,5 @@
-#include <memory>
+#include <cstdint>
+#include <ostream>
 
 
 #ifndef ORDER_H
@@ -6,35 +7,30 @@
 
 /*
 * Contains all the information of a simple order.
-* Each Order is represented as a node within a linked list.
+*
+* Orders are plain values used for incoming orders and fill reporting. Once an
+* order rests, the book copies its open state into an OrderPool slot.
+*
+* An iceberg order has a peak: only up to peak of its open quantity is shown
+* at a time, the rest is a hidden reserve that refills the shown tranche.
 */
 struct Order {
 public:
-    std::shared_ptr<Order> next_order{nullptr};
-    std::shared_ptr<Order> prev_order{nullptr};
-
-    Order(uint64_t id, uint64_t created_at, bool is_bid, uint64_t quantity, uint64_t filled_quantity, uint64_t price);
-
-    // copy constructor
-    Order(const Order& o);
-    Order& operator=(const Order& o);
-
-    // move constructor
-    Order(Order&& o);
-    Order& operator=(Order&& o);
-
-    virtual ~Order();
+    Order(uint64_t id, uint64_t created_at, bool is_bid, uint64_t quantity, uint64_t filled_quantity, uint64_t price, uint64_t owner=0, uint64_t peak=0);
 
     uint64_t id() const { return _id; };
-    uint64_t open_quantity() const;
+    uint64_t open_quantity() const { return _quantity - _filled_quantity; };
     uint64_t created_at() const { return _created_at; };
     bool is_bid() const { return _is_bid; };
     uint64_t quantity() const { return _quantity; };
     uint64_t filled_quantity() const { return _filled_quantity; };
     uint64_t filled_cost() const { return _filled_cost; };
     uint64_t price() const { return _price; };
+    uint64_t owner() const { return _owner; };
+    // 0 for orders shown in full
+    uint64_t peak() const { return _peak; };
 
-    void fill(uint64_t fill_quantity, uint64_t cost, uint64_t fill_id);
+    void fill(uint64_t fill_quantity, uint64_t cost, [[maybe_unused]] uint64_t fill_id) { _filled_quantity += fill_quantity; _filled_cost += cost; };
 
 private:
     uint64_t _id;
@@ -44,6 +40,8 @@ private:
     uint64_t _filled_quantity;
     uint64_t _filled_cost{0};
     uint64_t _price;
+    uint64_t _owner;
+    uint64_t _peak;
 };
 
 std::ostream& operator<<(std::ostream& os, const Order& o);
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "order_pool.h"
+
+
+OrderPool::OrderPool(Arena* arena)
+    :arena{arena}
+{}
+
+OrderPool::~OrderPool()
+{
+    for (uint32_t chunk = 0; chunk < hot.size(); chunk++)
+    {
+        if (hot[chunk] != nullptr)
+            freeChunk(chunk);
+    }
+}
+
+uint32_t OrderPool::allocate(const Order& order)
+{
+    if (order.open_quantity() > UINT32_MAX)
+    {
+        throw std::invalid_argument("Resting order quantity must fit in 32 bits.");
+    }
+
+    uint32_t open = order.open_quantity();
+    uint32_t shown = order.peak() == 0 ? open : std::min<uint64_t>(open, order.peak());
+    uint32_t index = takeSlot();
+    (*this)[index] = RestingOrder{
+        order.id(),
+        order.price(),
+        shown,
+        __NO_ORDER__,
+        __NO_ORDER__,
+        order.is_bid(),
+        order.owner() != 0,
+        shown < open,
+        0
+    };
+    info(index) = RestingOrderInfo{
+        order.created_at(),
+        order.quantity(),
+        order.owner(),
+        __NO_ORDER__,
+        __NO_ORDER__,
+        (uint32_t)order.peak(),
+        open - shown
+    };
+    return index;
+}
+
+void OrderPool::release(uint32_t index)
+{
+    uint32_t chunk = index >> __POOL_CHUNK_BITS__;
+    Chunk& c = meta[chunk];
+    RestingOrder& slot = (*this)[index];
+    slot.next = c.free_head;
+    slot.prev = __FREE_SLOT__;
+    c.free_head = index & __POOL_CHUNK_MASK__;
+    c.live--;
+    _size--;
+
+    if (!c.available && chunk != draining)
+    {
+        c.available = true;
+        available.push_back(chunk);
+    }
+}
+
+uint32_t OrderPool::takeSlot()
+{
+    // the chunk on top of the stack always has room
+    if (available.empty())
+    {
+        uint32_t chunk = addChunk();
+        meta[chunk].available = true;
+        available.push_back(chunk);
+    }
+
+    uint32_t chunk = available.back();
+    Chunk& c = meta[chunk];
+    uint32_t offset = c.free_head;
+    if (offset != __NO_ORDER__)
+        c.free_head = hot[chunk][offset].next;
+    else
+        offset = c.used++;
+
+    if (++c.live == __POOL_CHUNK_SIZE__)
+    {
+        c.available = false;
+        available.pop_back();
+    }
+    _size++;
+    return (chunk << __POOL_CHUNK_BITS__) | offset;
+}
+
+uint32_t OrderPool::addChunk()
+{
+    uint32_t chunk;
+    if (!released.empty())
+    {
+        chunk = released.back();
+        released.pop_back();
+    }
+    else {
+        if (hot.size() == __POOL_MAX_CHUNKS__)
+        {
+            throw std::length_error("Order pool is full.");
+        }
+        chunk = hot.size();
+        hot.push_back(nullptr);
+        cold.push_back(nullptr);
+        meta.emplace_back();
+    }
+
+    hot[chunk] = ArenaAllocator<RestingOrder>{arena}.allocate(__POOL_CHUNK_SIZE__);
+    cold[chunk] = ArenaAllocator<RestingOrderInfo>{arena}.allocate(__POOL_CHUNK_SIZE__);
+    meta[chunk] = Chunk{};
+    _chunks++;
+    return chunk;
+}
+
+void OrderPool::freeChunk(uint32_t chunk)
+{
+    ArenaAllocator<RestingOrder>{arena}.deallocate(hot[chunk], __POOL_CHUNK_SIZE__);
+    ArenaAllocator<RestingOrderInfo>{arena}.deallocate(cold[chunk], __POOL_CHUNK_SIZE__);
+    hot[chunk] = nullptr;
+    cold[chunk] = nullptr;
+    meta[chunk] = Chunk{};
+    released.push_back(chunk);
+    _chunks--;
+}
+
+size_t OrderPool::capacity() const
+{
+    size_t slots = 0;
+    for (uint32_t chunk = 0; chunk < meta.size(); chunk++)
+    {
+        slots += meta[chunk].used;
+    }
+    return slots;
+}
+
+size_t OrderPool::footprint() const
+{
+    size_t chunks = _chunks * __POOL_CHUNK_SIZE__ * (sizeof(RestingOrder) + sizeof(RestingOrderInfo));
+    size_t tables = hot.capacity() * sizeof(RestingOrder*) + cold.capacity() * sizeof(RestingOrderInfo*)
+        + meta.capacity() * sizeof(Chunk) + (available.capacity() + released.capacity()) * sizeof(uint32_t);
+    return chunks + tables;
+}
+
+uint32_t OrderPool::nextToMove()
+{
+    while (true)
+    {
+        if (draining == __NO_ORDER__)
+        {
+            // the other chunks need a free slot for every live order moved
+            if (_chunks < 2 || _chunks * __POOL_CHUNK_SIZE__ - _size < __POOL_CHUNK_SIZE__)
+            {
+                return __NO_ORDER__;
+            }
+
+            for (uint32_t chunk = 0; chunk < meta.size(); chunk++)
+            {
+                if (hot[chunk] != nullptr && (draining == __NO_ORDER__ || meta[chunk].live < meta[draining].live))
+                    draining = chunk;
+            }
+            drain_cursor = 0;
+
+            // keep new orders out of the chunk while it drains
+            Chunk& c = meta[draining];
+            if (c.available)
+            {
+                c.available = false;
+                available.erase(std::find(available.begin(), available.end(), draining));
+            }
+        }
+
+        Chunk& c = meta[draining];
+        if (c.live == 0)
+        {
+            freeChunk(draining);
+            draining = __NO_ORDER__;
+            continue;
+        }
+
+        // new orders took the free slots elsewhere: give up on this chunk
+        if ((_chunks - 1) * __POOL_CHUNK_SIZE__ == _size - c.live)
+        {
+            c.available = true;
+            available.push_back(draining);
+            draining = __NO_ORDER__;
+            return __NO_ORDER__;
+        }
+
+        // slots before the cursor were free or already moved
+        while (hot[draining][drain_cursor].prev == __FREE_SLOT__)
+        {
+            drain_cursor++;
+        }
+        return (draining << __POOL_CHUNK_BITS__) | drain_cursor;
+    }
+}
+
+uint32_t OrderPool::move(uint32_t index)
+{
+    uint32_t to = takeSlot();
+    (*this)[to] = (*this)[index];
+    info(to) = info(index);
+    release(index);
+    return to;
+}
@@ -0,0 +1,133 @@
+#include <cstdint>
+#include <vector>
+
+#include "order.h"
+#include "arena.h"
+
+
+#ifndef ORDER_POOL_H
+#define ORDER_POOL_H
+
+// null link for 32-bit order indices
+const uint32_t __NO_ORDER__{UINT32_MAX};
+// prev link of a released slot
+const uint32_t __FREE_SLOT__{UINT32_MAX - 1};
+
+const uint32_t __POOL_CHUNK_BITS__{12};
+const uint32_t __POOL_CHUNK_SIZE__{1u << __POOL_CHUNK_BITS__};
+const uint32_t __POOL_CHUNK_MASK__{__POOL_CHUNK_SIZE__ - 1};
+// keeps every index below __FREE_SLOT__
+const uint32_t __POOL_MAX_CHUNKS__{(1u << (32 - __POOL_CHUNK_BITS__)) - 1};
+
+/*
+* Fields of a resting order read or written while matching. Records are 32
+* bytes and 32-byte aligned, so each order touched costs one cache line.
+*/
+struct alignas(32) RestingOrder {
+    uint64_t id;
+    uint64_t price;
+    uint32_t open_quantity;
+    // level queue links; released slots link their chunk's free list through
+    // next and hold __FREE_SLOT__ in prev
+    uint32_t next;
+    uint32_t prev;
+    bool is_bid;
+    // only owned orders have owner links in the cold table
+    bool owned : 1;
+    // only icebergs may have a hidden reserve in the cold table
+    bool iceberg : 1;
+    // 1-based peg group of a pegged order, 0 for limit orders
+    uint16_t peg_group;
+};
+
+static_assert(sizeof(RestingOrder) == 32, "RestingOrder must stay half a cache line");
+
+/* Fields of a resting order only used outside of matching */
+struct RestingOrderInfo {
+    uint64_t created_at;
+    uint64_t quantity;
+    uint64_t owner;
+    // intrusive links through every resting order of the same owner
+    uint32_t owner_next;
+    uint32_t owner_prev;
+    // iceberg tranche size and the quantity not yet shown
+    uint32_t peak;
+    uint32_t hidden;
+};
+
+/*
+* Storage for the resting orders of a book, split into a hot table and a
+* parallel cold table indexed by the same 32-bit slot.
+*
+* Both tables are allocated in chunks of __POOL_CHUNK_SIZE__ slots, so the pool
+* grows without copying and can shrink a chunk at a time. Each chunk keeps its
+* own free list. To shrink, a chunk is drained by moving its live orders into
+* free slots of other chunks (the owner relinks each moved order), then freed.
+*/
+class OrderPool {
+public:
+    OrderPool(Arena* arena=nullptr);
+
+    OrderPool(const OrderPool& p) = delete;
+    OrderPool& operator=(const OrderPool& p) = delete;
+
+    ~OrderPool();
+
+    /*
+     * Copies the open state of order into a free slot and returns its index.
+     * An iceberg shows its first tranche, the rest goes to its hidden reserve.
+     */
+    uint32_t allocate(const Order& order);
+    void release(uint32_t index);
+
+    RestingOrder& operator[](uint32_t index) { return hot[index >> __POOL_CHUNK_BITS__][index & __POOL_CHUNK_MASK__]; };
+    const RestingOrder& operator[](uint32_t index) const { return hot[index >> __POOL_CHUNK_BITS__][index & __POOL_CHUNK_MASK__]; };
+    RestingOrderInfo& info(uint32_t index) { return cold[index >> __POOL_CHUNK_BITS__][index & __POOL_CHUNK_MASK__]; };
+
+    size_t size() const { return _size; };
+    /* Slots handed out at least once in the current chunks */
+    size_t capacity() const;
+    size_t chunks() const { return _chunks; };
+
+    /* Bytes held by the chunks and the chunk tables */
+    size_t footprint() const;
+
+    /*
+     * Next live order to move out of the chunk being drained, choosing the
+     * sparsest chunk when none is. Empty chunks are freed on the way. Returns
+     * __NO_ORDER__ when no chunk can be freed: the live orders would not fit
+     * in the remaining chunks.
+     */
+    uint32_t nextToMove();
+
+    /* Moves an order into a free slot outside the draining chunk */
+    uint32_t move(uint32_t index);
+
+private:
+    struct Chunk {
+        uint32_t free_head{__NO_ORDER__};
+        // slots handed out at least once, free or not
+        uint32_t used{0};
+        uint32_t live{0};
+        bool available{false};
+    };
+
+    Arena* arena;
+    std::vector<RestingOrder*> hot;
+    std::vector<RestingOrderInfo*> cold;
+    std::vector<Chunk> meta;
+    // chunks with free slots, newest on top, and ids of freed chunks
+    std::vector<uint32_t> available;
+    std::vector<uint32_t> released;
+    size_t _chunks{0};
+    size_t _size{0};
+
+    uint32_t draining{__NO_ORDER__};
+    uint32_t drain_cursor{0};
+
+    uint32_t takeSlot();
+    uint32_t addChunk();
+    void freeChunk(uint32_t chunk);
+};
+
+#endif
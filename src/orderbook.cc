@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include <memory>
 #include <chrono>
 #include <functional>
@@ -6,24 +7,26 @@
 #include <iomanip>
 
 #include "orderbook.h"
-#include "order.cc"
-#include "limit.cc"
 
 
-using std::shared_ptr;
 using std::chrono::milliseconds;
 
 
 uint8_t __MAX_TICK_SIZE__{8};
 
 OrderBook::OrderBook()
-    :tick_size{2}
-{
-    exp = pow(10, tick_size);
-}
+    :OrderBook(2)
+{}
 
-OrderBook::OrderBook(uint tick_size)
-    :tick_size(tick_size)
+OrderBook::OrderBook(uint tick_size, MatchingPolicy policy, Arena* arena)
+    :tick_size(tick_size),
+    _policy(policy),
+    arena(arena),
+    orders(arena),
+    order_ids(0, std::hash<uint64_t>{}, std::equal_to<uint64_t>{}, ArenaAllocator<OrderIndexEntry>{arena, &index_bytes}),
+    owner_orders(0, std::hash<uint64_t>{}, std::equal_to<uint64_t>{}, ArenaAllocator<OrderIndexEntry>{arena, &index_bytes}),
+    ask_limit_map(0, std::hash<uint>{}, std::equal_to<uint>{}, ArenaAllocator<LimitEntry>{arena, &level_bytes}),
+    bid_limit_map(0, std::hash<uint>{}, std::equal_to<uint>{}, ArenaAllocator<LimitEntry>{arena, &level_bytes})
 {
     if (tick_size > __MAX_TICK_SIZE__)
     {
@@ -58,11 +61,11 @@ uint64_t OrderBook::inside_bid_price() const
 
 double OrderBook::inside_bid_quantity() const
 {
-    if (highest_bid_limit == nullptr || highest_bid_limit->head_order == nullptr)
+    if (highest_bid_limit == nullptr || highest_bid_limit->head_order == __NO_ORDER__)
     {
         return 0;
     }
-    return highest_bid_limit->head_order->open_quantity();
+    return orders[highest_bid_limit->head_order].open_quantity;
 }
 
 
@@ -77,63 +80,27 @@ uint64_t OrderBook::inside_ask_price() const
 
 double OrderBook::inside_ask_quantity() const
 {
-    if (lowest_ask_limit == nullptr || lowest_ask_limit->head_order == nullptr)
+    if (lowest_ask_limit == nullptr || lowest_ask_limit->head_order == __NO_ORDER__)
     {
         return 0;
     }
-    return lowest_ask_limit->head_order->open_quantity();
+    return orders[lowest_ask_limit->head_order].open_quantity;
 }
 
 
 Limit& OrderBook::createBidLimit(uint64_t price)
 {
     Limit& limit = bid_limit_map[price] = Limit{price};
-    if (highest_bid_limit == nullptr)
-    {
-        highest_bid_limit = &limit;
-        return limit;
-    }
-    if (price > highest_bid_limit->price())
-    {
-        limit.next = highest_bid_limit;
-        highest_bid_limit = &limit;
-        return limit;
-    }
-
-    // insert limit into correct position within linked list
-    Limit* head = highest_bid_limit;
-    while (head->next != nullptr && head->next->price() > price)
-    {
-        head = head->next;
-    }
-    limit.next = head->next;
-    head->next = &limit;
+    limit.snapshot_epoch = snapshot_epoch;
+    linkLevel(highest_bid_limit, limit, true);
     return limit;
 }
 
 Limit& OrderBook::createAskLimit(uint64_t price)
 {
     Limit& limit = ask_limit_map[price] = Limit{price};
-    if (lowest_ask_limit == nullptr)
-    {
-        lowest_ask_limit = &limit;
-        return limit;
-    }
-    if (price < lowest_ask_limit->price())
-    {
-        limit.next = lowest_ask_limit;
-        lowest_ask_limit = &limit;
-        return limit;
-    }
-
-    // insert limit into correct position within limit linked list
-    Limit* head = lowest_ask_limit;
-    while (head->next != nullptr && head->next->price() < price)
-    {
-        head = head->next;
-    }
-    limit.next = head->next;
-    head->next = &limit;
+    limit.snapshot_epoch = snapshot_epoch;
+    linkLevel(lowest_ask_limit, limit, false);
     return limit;
 }
 
@@ -165,11 +132,14 @@ uint64_t getTimestamp()
     return ms.count();
 }
 
-Order OrderBook::createOrder(bool is_bid, uint64_t quantity, uint64_t filled_quantity, double price)
+Order OrderBook::createOrder(bool is_bid, uint64_t quantity, uint64_t filled_quantity, double price, uint64_t owner)
 {
     // convert price from tick units to pennies
-    uint64_t format_price = formatLevelPrice(price);
+    return createLevelOrder(is_bid, quantity, filled_quantity, formatLevelPrice(price), owner);
+}
 
+Order OrderBook::createLevelOrder(bool is_bid, uint64_t quantity, uint64_t filled_quantity, uint64_t price, uint64_t owner)
+{
     // create order and add to the book order map
     uint64_t created_at = getTimestamp();
     uint64_t order_id = next_id++;
@@ -179,113 +149,986 @@ Order OrderBook::createOrder(bool is_bid, uint64_t quantity, uint64_t filled_qua
                 is_bid,
                 quantity,
                 filled_quantity,
-                format_price
+                price,
+                owner
             };
     return order;
 }
 
-void OrderBook::removeOrder(shared_ptr<Order> order)
+Order OrderBook::createIcebergOrder(bool is_bid, uint64_t quantity, uint64_t peak, uint64_t price, uint64_t owner)
+{
+    if (peak == 0 || peak >= quantity)
+    {
+        throw std::invalid_argument("Iceberg peak must be positive and below the order quantity.");
+    }
+    return Order{next_id++, getTimestamp(), is_bid, quantity, 0, price, owner, peak};
+}
+
+void OrderBook::removeOrder(Limit& limit, uint32_t order)
 {
-    Limit& limit = getLimit(order->is_bid(), order->price());
-    limit.removeOrder(order);
+    if (orders[order].peg_group == 0)
+        depthCache(orders[order].is_bid).invalidate(limit.price());
+    order_ids.erase(orders[order].id);
+    unlinkOwner(order);
+    limit.removeOrder(orders, order);
+    orders.release(order);
     _size--;
     return;
 }
 
-bool OrderBook::matchOrder(Limit* limit, LimitMap limit_map, Order& order)
+void OrderBook::linkOwner(uint32_t order)
 {
-    // iterate through best price limit and match orders with new order
-    CompareCallback compare = buildCompareCallback(order.is_bid());
-    while (limit != nullptr && compare(limit->price(), order.price()))
+    if (!orders[order].owned)
+    {
+        return;
+    }
+
+    // newest order becomes the head of the owner list
+    RestingOrderInfo& info = orders.info(order);
+    auto [it, added] = owner_orders.try_emplace(info.owner, order);
+    info.owner_next = added ? __NO_ORDER__ : it->second;
+    info.owner_prev = __NO_ORDER__;
+    if (!added)
+    {
+        orders.info(it->second).owner_prev = order;
+        it->second = order;
+    }
+}
+
+void OrderBook::unlinkOwner(uint32_t order)
+{
+    if (!orders[order].owned)
+    {
+        return;
+    }
+
+    RestingOrderInfo& info = orders.info(order);
+    if (info.owner_prev != __NO_ORDER__)
+    {
+        orders.info(info.owner_prev).owner_next = info.owner_next;
+    }
+    else if (info.owner_next != __NO_ORDER__) {
+        owner_orders[info.owner] = info.owner_next;
+    }
+    else {
+        owner_orders.erase(info.owner);
+    }
+
+    if (info.owner_next != __NO_ORDER__)
+    {
+        orders.info(info.owner_next).owner_prev = info.owner_prev;
+    }
+    info.owner_next = info.owner_prev = __NO_ORDER__;
+}
+
+void OrderBook::eraseLimit(Limit& limit, bool is_bid)
+{
+    if (snapshot_cursor == &limit)
+        snapshot_cursor = limit.next;
+
+    unlinkLevel(is_bid ? highest_bid_limit : lowest_ask_limit, limit);
+
+    LimitMap& limit_map = is_bid ? bid_limit_map : ask_limit_map;
+    limit_map.erase(limit.price());
+}
+
+void OrderBook::matchPriceTime(Limit& limit, Order& order)
+{
+    uint32_t current_order = limit.head_order;
+    while (current_order != __NO_ORDER__ && order.open_quantity() > 0)
     {
-        if (order.open_quantity() == 0)
+        RestingOrder& resting = orders[current_order];
+        uint64_t price = limit.price();
+        uint64_t quantity = std::min<uint64_t>(resting.open_quantity, order.open_quantity());
+        uint64_t cost = price * quantity;
+
+        order.fill(quantity, cost, fill_id++);
+        limit.fillOrder(orders, current_order, quantity);
+        recordTrade(price, quantity, order.is_bid(), resting.id, order.id(), order.created_at());
+
+        // incoming order exhausted with the resting order still open
+        if (resting.open_quantity > 0)
             break;
 
-        shared_ptr<Order> current_order = limit->head_order;
-        while (current_order != nullptr)
+        // an iceberg refills and requeues at the tail, anything else leaves
+        if (!limit.replenishOrder(orders, current_order, order.created_at()))
+            removeOrder(limit, current_order);
+        current_order = limit.head_order;
+    }
+}
+
+void OrderBook::matchProRata(Limit& limit, Order& order)
+{
+    // an order that takes the whole level fills every resting order in full
+    if (order.open_quantity() >= limit.visible_volume())
+    {
+        matchPriceTime(limit, order);
+        return;
+    }
+
+    // gather open quantities in arrival order into contiguous scratch space
+    level_quantities.clear();
+    for (uint32_t o = limit.head_order; o != __NO_ORDER__; o = orders[o].next)
+    {
+        level_quantities.push_back(orders[o].open_quantity);
+    }
+    size_t count = level_quantities.size();
+    level_allocations.resize(count);
+
+    uint64_t quantity = order.open_quantity();
+    proRataAllocate(level_quantities.data(), level_allocations.data(), count, limit.visible_volume(), quantity);
+
+    // each share loses under one lot to rounding, so the remainder is below count
+    uint64_t allocated = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        allocated += level_allocations[i];
+    }
+    uint64_t remainder = quantity - allocated;
+    for (size_t i = 0; i < count && remainder > 0; i++)
+    {
+        if (level_allocations[i] < level_quantities[i])
         {
-            uint64_t price = order.is_bid() ? current_order->price() : order.price();
-            if (current_order->open_quantity() > order.open_quantity())
-            {
-                uint64_t cost = price * order.open_quantity();
+            level_allocations[i]++;
+            remainder--;
+        }
+    }
 
-                // NOTE: fill() call-order matters—quantity will change
-                current_order->fill(order.open_quantity(), cost, fill_id++);
-                order.fill(order.open_quantity(), cost, fill_id);
-                break;
-            }
+    uint32_t current_order = limit.head_order;
+    for (size_t i = 0; i < count; i++)
+    {
+        RestingOrder& resting = orders[current_order];
+        uint32_t next_order = resting.next;
+        uint64_t fill_quantity = level_allocations[i];
+        if (fill_quantity > 0)
+        {
+            uint64_t price = limit.price();
+            uint64_t cost = price * fill_quantity;
 
-            if (current_order->open_quantity() <= order.open_quantity())
-            {
-                uint64_t cost = price * current_order->open_quantity();
+            order.fill(fill_quantity, cost, fill_id++);
+            limit.fillOrder(orders, current_order, fill_quantity);
+            recordTrade(price, fill_quantity, order.is_bid(), resting.id, order.id(), order.created_at());
 
-                // NOTE: fill() call-order matters—quantity will change
-                order.fill(current_order->open_quantity(), cost, fill_id++);
-                current_order->fill(current_order->open_quantity(), cost, fill_id);
+            // a requeued iceberg lands after the orders still to visit
+            if (resting.open_quantity == 0 && !limit.replenishOrder(orders, current_order, order.created_at()))
+                removeOrder(limit, current_order);
+        }
+        current_order = next_order;
+    }
+}
 
-                // remove current order from book and return next order
-                removeOrder(current_order);
-                current_order = limit->head_order;
-            }
+void OrderBook::matchLevel(Limit& limit, Order& order)
+{
+    if (_policy == MatchingPolicy::ProRata)
+        matchProRata(limit, order);
+    else
+        matchPriceTime(limit, order);
+}
+
+bool OrderBook::matchOrder(Limit* limit, Order& order)
+{
+    // iterate through best price limit and match orders with new order
+    CompareCallback compare = buildCompareCallback(order.is_bid());
+    while (order.open_quantity() > 0)
+    {
+        bool crosses = limit != nullptr && compare(limit->price(), order.price());
+
+        // pegged orders strictly better than the next level match first,
+        // at the same price limit orders keep priority
+        PegGroup* group = bestPegGroup(!order.is_bid(), order);
+        if (group != nullptr && (!crosses || (order.is_bid() ? group->queue.price() < limit->price() : group->queue.price() > limit->price())))
+        {
+            matchLevel(group->queue, order);
+            continue;
         }
+        if (!crosses)
+            break;
+
+        preserveLevel(*limit, !order.is_bid());
+        matchLevel(*limit, order);
 
+        // one depth update per touched level, after all of its fills
+        levelChanged(*limit, !order.is_bid());
 
         // orders exhausted for this limit, move to next best limit
         if (limit->size() == 0)
         {
             Limit* empty_limit = limit;
-
-            Limit* next_limit = limit->next;
-            limit = next_limit;
-            if (order.is_bid())
-            {
-                lowest_ask_limit = next_limit;
-            }
-            else {
-                highest_bid_limit = next_limit;
-            }
-
-            limit_map.erase(empty_limit->price());
+            limit = limit->next;
+            eraseLimit(*empty_limit, !order.is_bid());
         }
     }
 
     return (order.open_quantity() == 0);
 }
 
+void OrderBook::restOrder(Order& order)
+{
+    // take the slot first so a failed allocation leaves no empty level behind
+    uint32_t resting = orders.allocate(order);
+    Limit& limit = getLimit(order.is_bid(), order.price());
+    preserveLevel(limit, order.is_bid());
+    limit.addOrder(orders, resting);
+    order_ids[order.id()] = resting;
+    linkOwner(resting);
+    levelChanged(limit, order.is_bid());
+    _size++;
+    return;
+}
+
 void OrderBook::addOrder(Order& order)
 {
-    // find best priced limit—assume / default new order as a bid
-    // NOTE: limit must be the opposite side of incoming order to match orders
-    LimitMap limit_map = ask_limit_map;
-    Limit* best_limit = lowest_ask_limit;
-    if (!order.is_bid())
+    tracePoint(TraceStage::AddOrder);
+
+    // reject before matching: a remainder too large to rest would be left half-applied
+    if (order.open_quantity() > UINT32_MAX)
     {
-        limit_map = bid_limit_map;
-        best_limit = highest_bid_limit;
+        throw std::invalid_argument("Order quantity must fit in 32 bits.");
     }
 
-    // if no limit and opposing orders are found, create new limit and new order
-    if (best_limit == nullptr)
+    // orders accumulate without matching until the auction is uncrossed
+    if (_auction_mode)
     {
-        Limit& limit = getLimit(order.is_bid(), order.price());
-        limit.addOrder(std::make_shared<Order>(order));
-        _size++;
+        restOrder(order);
+        tracePoint(TraceStage::Publish);
         return;
     }
 
-    bool matched = matchOrder(best_limit, limit_map, order);
+    // find best priced limit—assume / default new order as a bid
+    // NOTE: limit must be the opposite side of incoming order to match orders
+    Limit* best_limit = order.is_bid() ? lowest_ask_limit : highest_bid_limit;
+
+    bool matched = matchOrder(best_limit, order);
+    tracePoint(TraceStage::Match);
 
     // order unfulfilled—add order to limit
     if (!matched)
     {
-        Limit& limit = getLimit(order.is_bid(), order.price());
-        limit.addOrder(std::make_shared<Order>(order));
-        _size++;
+        restOrder(order);
     }
 
+    repricePegs();
+    tracePoint(TraceStage::Publish);
     return;
 }
 
+uint64_t OrderBook::addPeggedOrder(bool is_bid, uint64_t quantity, PegType type, int64_t offset, uint64_t owner)
+{
+    if (is_bid ? offset > 0 : offset < 0)
+    {
+        throw std::invalid_argument("Peg offset must not be aggressive.");
+    }
+
+    // groups are never released so a group's index stays valid in its orders
+    uint16_t group = 0;
+    while (group < peg_groups.size())
+    {
+        const PegGroup& g = peg_groups[group];
+        if (g.is_bid == is_bid && g.type == type && g.offset == offset)
+            break;
+        group++;
+    }
+    if (group == peg_groups.size())
+    {
+        if (group == UINT16_MAX)
+        {
+            throw std::length_error("Too many peg groups.");
+        }
+        peg_groups.push_back(PegGroup{is_bid, type, offset, Limit{pegPrice(is_bid, type, offset)}});
+    }
+
+    // pegged orders join their group's queue without matching on entry
+    Order order = createLevelOrder(is_bid, quantity, 0, 0, owner);
+    uint32_t resting = orders.allocate(order);
+    orders[resting].peg_group = group + 1;
+    peg_groups[group].queue.addOrder(orders, resting);
+    order_ids[order.id()] = resting;
+    linkOwner(resting);
+    _size++;
+    return order.id();
+}
+
+uint64_t OrderBook::pegPrice(bool is_bid, PegType type, int64_t offset) const
+{
+    uint64_t bid = inside_bid_price();
+    uint64_t ask = inside_ask_price();
+    uint64_t reference = 0;
+    if (type == PegType::Primary)
+    {
+        reference = is_bid ? bid : ask;
+    }
+    else if (bid != 0 && ask != 0)
+    {
+        // a one-tick spread has no midpoint, so mid pegs join the inside
+        reference = is_bid ? std::max(bid, (bid + ask - 1) / 2) : std::min(ask, (bid + ask) / 2 + 1);
+    }
+
+    if (reference == 0 || (offset < 0 && reference <= (uint64_t)-offset))
+    {
+        return 0;
+    }
+    return reference + offset;
+}
+
+PegGroup* OrderBook::bestPegGroup(bool is_bid, const Order& order)
+{
+    PegGroup* best = nullptr;
+    for (PegGroup& group : peg_groups)
+    {
+        uint64_t price = group.queue.price();
+        if (group.is_bid != is_bid || price == 0 || group.queue.size() == 0)
+            continue;
+        if (is_bid ? price < order.price() : price > order.price())
+            continue;
+        // ties keep the earlier group
+        if (best == nullptr || (is_bid ? price > best->queue.price() : price < best->queue.price()))
+            best = &group;
+    }
+    return best;
+}
+
+void OrderBook::repricePegs()
+{
+    uint64_t bid = inside_bid_price();
+    uint64_t ask = inside_ask_price();
+    if (_auction_mode || (bid == peg_bid && ask == peg_ask))
+    {
+        return;
+    }
+    peg_bid = bid;
+    peg_ask = ask;
+
+    // one store per group however many orders it holds
+    for (PegGroup& group : peg_groups)
+    {
+        group.queue.reprice(pegPrice(group.is_bid, group.type, group.offset));
+    }
+}
+
+Limit& OrderBook::restingLimit(uint32_t order)
+{
+    const RestingOrder& resting = orders[order];
+    if (resting.peg_group != 0)
+    {
+        return peg_groups[resting.peg_group - 1].queue;
+    }
+    return resting.is_bid ? bid_limit_map.at(resting.price) : ask_limit_map.at(resting.price);
+}
+
+void OrderBook::relocateOrder(uint32_t order)
+{
+    Limit& limit = restingLimit(order);
+    uint32_t moved = orders.move(order);
+    RestingOrder& resting = orders[moved];
+
+    if (resting.prev != __NO_ORDER__)
+        orders[resting.prev].next = moved;
+    else
+        limit.head_order = moved;
+    if (resting.next != __NO_ORDER__)
+        orders[resting.next].prev = moved;
+    else
+        limit.tail_order = moved;
+
+    if (resting.owned)
+    {
+        RestingOrderInfo& info = orders.info(moved);
+        if (info.owner_prev != __NO_ORDER__)
+            orders.info(info.owner_prev).owner_next = moved;
+        else
+            owner_orders[info.owner] = moved;
+        if (info.owner_next != __NO_ORDER__)
+            orders.info(info.owner_next).owner_prev = moved;
+    }
+
+    order_ids[resting.id] = moved;
+}
+
+MemoryFootprint OrderBook::memory() const
+{
+    return MemoryFootprint{
+        orders.footprint(),
+        level_bytes + peg_groups.capacity() * sizeof(PegGroup),
+        index_bytes
+    };
+}
+
+/* Shrinks a hash table's buckets once they outnumber its entries four to one */
+template<typename Map>
+static bool shrinkBuckets(Map& map)
+{
+    if (map.size() > __COMPACT_REHASH_LIMIT__ || map.bucket_count() <= 4 * std::max<size_t>(map.size(), 2))
+    {
+        return false;
+    }
+    map.rehash(0);
+    return true;
+}
+
+bool OrderBook::compact(size_t max_moves)
+{
+    if (!overBudget())
+    {
+        return false;
+    }
+
+    // orders first: freeing a chunk gives back far more than any bucket array
+    for (size_t moves = 0; moves < max_moves; moves++)
+    {
+        uint32_t order = orders.nextToMove();
+        if (order == __NO_ORDER__)
+            break;
+        relocateOrder(order);
+        if (moves + 1 == max_moves)
+            return true;
+    }
+
+    // one table per step
+    if (shrinkBuckets(bid_limit_map) || shrinkBuckets(ask_limit_map)
+        || shrinkBuckets(order_ids) || shrinkBuckets(owner_orders))
+    {
+        return true;
+    }
+    return false;
+}
+
+void OrderBook::setAuctionMode(bool enabled)
+{
+    if (_auction_mode && !enabled)
+    {
+        uncross();
+    }
+    _auction_mode = enabled;
+    repricePegs();
+}
+
+AuctionResult OrderBook::indicativeUncross() const
+{
+    AuctionResult result{0, 0};
+    if (highest_bid_limit == nullptr || lowest_ask_limit == nullptr
+        || highest_bid_limit->price() < lowest_ask_limit->price())
+    {
+        return result;
+    }
+
+    // cumulative depth of crossed levels: bids at or above, asks at or below
+    uint64_t low = lowest_ask_limit->price();
+    uint64_t high = highest_bid_limit->price();
+    std::vector<std::pair<uint64_t, uint64_t>> bid_depth;
+    std::vector<std::pair<uint64_t, uint64_t>> ask_depth;
+    uint64_t cumulative = 0;
+    for (Limit* limit = highest_bid_limit; limit != nullptr && limit->price() >= low; limit = limit->next)
+    {
+        cumulative += limit->total_volume();
+        bid_depth.push_back({limit->price(), cumulative});
+    }
+    cumulative = 0;
+    for (Limit* limit = lowest_ask_limit; limit != nullptr && limit->price() <= high; limit = limit->next)
+    {
+        cumulative += limit->total_volume();
+        ask_depth.push_back({limit->price(), cumulative});
+    }
+
+    // walk candidate prices upwards: ask depth grows while bid depth shrinks
+    size_t a = 0;
+    size_t b = bid_depth.size();
+    uint64_t best_imbalance = 0;
+    while (a < ask_depth.size() || b > 0)
+    {
+        uint64_t ask_price = a < ask_depth.size() ? ask_depth[a].first : UINT64_MAX;
+        uint64_t bid_price = b > 0 ? bid_depth[b - 1].first : UINT64_MAX;
+        uint64_t price = std::min(ask_price, bid_price);
+
+        // bids priced at or above p, asks priced at or below p
+        while (a < ask_depth.size() && ask_depth[a].first <= price)
+            a++;
+        uint64_t asks = a > 0 ? ask_depth[a - 1].second : 0;
+        uint64_t bids = b > 0 ? bid_depth[b - 1].second : 0;
+        while (b > 0 && bid_depth[b - 1].first <= price)
+            b--;
+
+        uint64_t volume = std::min(bids, asks);
+        uint64_t imbalance = bids > asks ? bids - asks : asks - bids;
+        if (volume > result.volume || (volume == result.volume && volume > 0 && imbalance < best_imbalance))
+        {
+            result = AuctionResult{price, volume};
+            best_imbalance = imbalance;
+        }
+    }
+
+    return result;
+}
+
+AuctionResult OrderBook::uncross()
+{
+    AuctionResult result = indicativeUncross();
+    if (result.volume == 0)
+    {
+        return result;
+    }
+
+    // pair bids and asks in price-time priority, all at the equilibrium price
+    uint64_t now = getTimestamp();
+    uint64_t remaining = result.volume;
+    Limit* bid_limit = highest_bid_limit;
+    Limit* ask_limit = lowest_ask_limit;
+    while (remaining > 0)
+    {
+        uint32_t bid = bid_limit->head_order;
+        uint32_t ask = ask_limit->head_order;
+        uint64_t quantity = std::min<uint64_t>({remaining, orders[bid].open_quantity, orders[ask].open_quantity});
+        preserveLevel(*bid_limit, true);
+        preserveLevel(*ask_limit, false);
+
+        bid_limit->fillOrder(orders, bid, quantity);
+        ask_limit->fillOrder(orders, ask, quantity);
+        fill_id++;
+        recordTrade(result.price, quantity, true, orders[ask].id, orders[bid].id, now);
+        remaining -= quantity;
+
+        if (orders[bid].open_quantity == 0 && !bid_limit->replenishOrder(orders, bid, now))
+            removeOrder(*bid_limit, bid);
+        if (orders[ask].open_quantity == 0 && !ask_limit->replenishOrder(orders, ask, now))
+            removeOrder(*ask_limit, ask);
+
+        // one depth update per level, once it is exhausted or matching ends
+        if (bid_limit->size() == 0 || remaining == 0)
+            levelChanged(*bid_limit, true);
+        if (ask_limit->size() == 0 || remaining == 0)
+            levelChanged(*ask_limit, false);
+
+        // move past exhausted levels, leaving them for releaseEmptyLimits
+        if (bid_limit->size() == 0)
+            bid_limit = bid_limit->next;
+        if (ask_limit->size() == 0)
+            ask_limit = ask_limit->next;
+    }
+
+    releaseEmptyLimits(true);
+    releaseEmptyLimits(false);
+    return result;
+}
+
+void OrderBook::releaseEmptyLimits(bool is_bid)
+{
+    Limit* best_limit = is_bid ? highest_bid_limit : lowest_ask_limit;
+    while (best_limit != nullptr && best_limit->size() == 0)
+    {
+        Limit* empty_limit = best_limit;
+        best_limit = best_limit->next;
+        eraseLimit(*empty_limit, is_bid);
+    }
+}
+
+uint64_t OrderBook::sendMarketOrder(bool is_bid, uint quantity)
+{
+    // a market order crosses every level and never rests
+    Order order = createLevelOrder(is_bid, quantity, 0, is_bid ? UINT64_MAX : 0);
+    sendImmediateOrder(order);
+    return order.filled_quantity();
+}
+
+void OrderBook::sendImmediateOrder(Order& order)
+{
+    if (_auction_mode)
+    {
+        return;
+    }
+
+    Limit* best_limit = order.is_bid() ? lowest_ask_limit : highest_bid_limit;
+    matchOrder(best_limit, order);
+    repricePegs();
+}
+
+uint64_t OrderBook::sendCancelOrder(uint64_t order_id)
+{
+    auto it = order_ids.find(order_id);
+    if (it == order_ids.end())
+    {
+        return 0;
+    }
+    return reduceResting(it->second, UINT64_MAX);
+}
+
+uint64_t OrderBook::reduceOrder(uint64_t order_id, uint64_t quantity)
+{
+    auto it = order_ids.find(order_id);
+    if (it == order_ids.end())
+    {
+        return 0;
+    }
+    return reduceResting(it->second, quantity);
+}
+
+uint64_t OrderBook::executeOrder(uint64_t order_id, uint64_t quantity, uint64_t price)
+{
+    auto it = order_ids.find(order_id);
+    if (it == order_ids.end())
+    {
+        return 0;
+    }
+
+    // the aggressor is on the opposite side of the resting order
+    const RestingOrder& resting = orders[it->second];
+    uint64_t executed = std::min<uint64_t>(quantity, resting.open_quantity);
+    if (executed == 0)
+    {
+        return 0;
+    }
+    fill_id++;
+    recordTrade(price == 0 ? restingLimit(it->second).price() : price, executed, !resting.is_bid, resting.id, 0, getTimestamp());
+    return reduceResting(it->second, executed);
+}
+
+uint64_t OrderBook::replaceOrder(uint64_t order_id, uint64_t new_id, uint64_t quantity, uint64_t price)
+{
+    auto it = order_ids.find(order_id);
+    if (it == order_ids.end())
+    {
+        return 0;
+    }
+
+    bool is_bid = orders[it->second].is_bid;
+    uint64_t owner = orders.info(it->second).owner;
+    uint64_t peak = orders[it->second].iceberg ? orders.info(it->second).peak : 0;
+    reduceResting(it->second, UINT64_MAX);
+
+    Order order{new_id, getTimestamp(), is_bid, quantity, 0, price, owner, peak};
+    addOrder(order);
+    return quantity;
+}
+
+uint64_t OrderBook::reduceResting(uint32_t order, uint64_t quantity)
+{
+    RestingOrder& resting = orders[order];
+    bool is_bid = resting.is_bid;
+    bool pegged = resting.peg_group != 0;
+    Limit& limit = restingLimit(order);
+    if (!pegged)
+        preserveLevel(limit, is_bid);
+
+    uint64_t hidden = resting.iceberg ? orders.info(order).hidden : 0;
+    uint64_t reduced = std::min<uint64_t>(quantity, resting.open_quantity + hidden);
+    if (reduced == resting.open_quantity + hidden)
+    {
+        removeOrder(limit, order);
+    }
+    else {
+        // a partial reduction comes out of the hidden reserve first so the
+        // shown tranche keeps its place; only the rest is taken off the order
+        // and level like a fill, and leaves some of the tranche shown
+        uint64_t from_reserve = std::min<uint64_t>(reduced, hidden);
+        if (from_reserve > 0)
+            limit.reduceReserve(orders, order, from_reserve);
+        limit.fillOrder(orders, order, reduced - from_reserve);
+    }
+
+    // peg queues are not displayed and are never erased
+    if (pegged)
+    {
+        return reduced;
+    }
+
+    levelChanged(limit, is_bid);
+    if (limit.size() == 0)
+    {
+        eraseLimit(limit, is_bid);
+    }
+    repricePegs();
+    return reduced;
+}
+
+MassCancelResult OrderBook::cancelOwnerOrders(uint64_t owner)
+{
+    std::vector<std::pair<bool, uint64_t>> touched;
+    MassCancelResult result{0, 0, 0};
+
+    auto it = owner_orders.find(owner);
+    uint32_t order = it == owner_orders.end() ? __NO_ORDER__ : it->second;
+    while (order != __NO_ORDER__)
+    {
+        // read the owner link first, cancelling frees the slot
+        uint32_t next = orders.info(order).owner_next;
+        cancelResting(order, touched, result);
+        order = next;
+    }
+
+    finishMassCancel(touched, result, owner);
+    return result;
+}
+
+MassCancelResult OrderBook::cancelSide(bool is_bid)
+{
+    std::vector<std::pair<bool, uint64_t>> touched;
+    MassCancelResult result{0, 0, 0};
+
+    for (PegGroup& group : peg_groups)
+    {
+        while (group.is_bid == is_bid && group.queue.head_order != __NO_ORDER__)
+        {
+            cancelResting(group.queue.head_order, touched, result);
+        }
+    }
+
+    cancelLevels(is_bid, 0, UINT64_MAX, touched, result);
+    finishMassCancel(touched, result, 0);
+    return result;
+}
+
+MassCancelResult OrderBook::cancelPriceRange(bool is_bid, uint64_t low, uint64_t high)
+{
+    std::vector<std::pair<bool, uint64_t>> touched;
+    MassCancelResult result{0, 0, 0};
+    cancelLevels(is_bid, low, high, touched, result);
+    finishMassCancel(touched, result, 0);
+    return result;
+}
+
+void OrderBook::cancelLevels(bool is_bid, uint64_t low, uint64_t high, std::vector<std::pair<bool, uint64_t>>& touched, MassCancelResult& result)
+{
+    // levels are sorted from the inside out, so stop once past the range
+    Limit* limit = is_bid ? highest_bid_limit : lowest_ask_limit;
+    while (limit != nullptr)
+    {
+        Limit* next = limit->next;
+        bool past = is_bid ? limit->price() < low : limit->price() > high;
+        if (past)
+            break;
+
+        if (limit->price() >= low && limit->price() <= high)
+        {
+            while (limit->head_order != __NO_ORDER__)
+            {
+                cancelResting(limit->head_order, touched, result);
+            }
+        }
+        limit = next;
+    }
+}
+
+void OrderBook::cancelResting(uint32_t order, std::vector<std::pair<bool, uint64_t>>& touched, MassCancelResult& result)
+{
+    bool is_bid = orders[order].is_bid;
+    bool pegged = orders[order].peg_group != 0;
+    uint64_t price = orders[order].price;
+    result.orders++;
+    result.volume += orders[order].open_quantity;
+    if (orders[order].iceberg)
+    {
+        result.volume += orders.info(order).hidden;
+        result.hidden += orders.info(order).hidden;
+    }
+
+    Limit& limit = restingLimit(order);
+    if (!pegged)
+    {
+        preserveLevel(limit, is_bid);
+        touched.push_back({is_bid, price});
+    }
+    removeOrder(limit, order);
+}
+
+void OrderBook::finishMassCancel(std::vector<std::pair<bool, uint64_t>>& touched, MassCancelResult& result, uint64_t owner)
+{
+    if (result.orders == 0)
+    {
+        return;
+    }
+
+    // one depth update per touched level, reclaiming levels left empty
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (auto& [is_bid, price] : touched)
+    {
+        Limit& limit = is_bid ? bid_limit_map.at(price) : ask_limit_map.at(price);
+        levelChanged(limit, is_bid);
+        if (limit.size() == 0)
+        {
+            eraseLimit(limit, is_bid);
+        }
+    }
+
+    if (publisher != nullptr)
+    {
+        // the feed never reveals iceberg reserves
+        publisher->publishMassCancel(owner, result.orders, result.volume - result.hidden);
+    }
+    repricePegs();
+}
+
+void OrderBook::recordTrade(uint64_t price, uint64_t quantity, bool is_bid, uint64_t maker_id, uint64_t taker_id, uint64_t timestamp)
+{
+    statistics.record(price, quantity, timestamp);
+    if (publisher != nullptr)
+    {
+        publisher->publishTrade(price, quantity, is_bid, maker_id, taker_id);
+    }
+}
+
+void OrderBook::beginSnapshot(std::vector<MarketDataLevel>& bids, std::vector<MarketDataLevel>& asks, uint32_t epoch)
+{
+    // every level is preserved at most once, so the vectors never grow past this
+    bids.clear();
+    asks.clear();
+    bids.reserve(bid_limit_map.size());
+    asks.reserve(ask_limit_map.size());
+
+    snapshot_bids = &bids;
+    snapshot_asks = &asks;
+    snapshot_epoch = epoch;
+    snapshot_cursor = highest_bid_limit;
+    snapshot_cursor_bid = true;
+}
+
+bool OrderBook::copySnapshotLevels(size_t& levels)
+{
+    while (snapshot_bids != nullptr && levels > 0)
+    {
+        if (snapshot_cursor == nullptr)
+        {
+            if (snapshot_cursor_bid)
+            {
+                snapshot_cursor = lowest_ask_limit;
+                snapshot_cursor_bid = false;
+                continue;
+            }
+            snapshot_bids = nullptr;
+            snapshot_asks = nullptr;
+            break;
+        }
+
+        Limit* limit = snapshot_cursor;
+        snapshot_cursor = limit->next;
+        preserveLevel(*limit, snapshot_cursor_bid);
+        levels--;
+    }
+    return snapshot_bids == nullptr;
+}
+
+void OrderBook::preserveLevel(Limit& limit, bool is_bid)
+{
+    if (snapshot_bids == nullptr || limit.snapshot_epoch == snapshot_epoch)
+    {
+        return;
+    }
+    limit.snapshot_epoch = snapshot_epoch;
+    std::vector<MarketDataLevel>& levels = is_bid ? *snapshot_bids : *snapshot_asks;
+    levels.push_back(MarketDataLevel{limit.price(), limit.visible_volume(), limit.size()});
+}
+
+void OrderBook::levelChanged(const Limit& limit, bool is_bid)
+{
+    depthCache(is_bid).invalidate(limit.price());
+    if (publisher == nullptr)
+    {
+        return;
+    }
+    publisher->publishDepth(is_bid, limit.price(), limit.visible_volume(), limit.size());
+}
+
+uint64_t OrderBook::depthVolume(bool is_bid, size_t levels) const
+{
+    if (levels == 0)
+    {
+        return 0;
+    }
+
+    DepthCache& cache = depthCache(is_bid);
+    cache.extend(is_bid ? highest_bid_limit : lowest_ask_limit, levels);
+    const std::vector<DepthLevel>& cached = cache.levels();
+    if (cached.empty())
+    {
+        return 0;
+    }
+    return cached[std::min(levels, cached.size()) - 1].cumulative_volume;
+}
+
+uint64_t OrderBook::volumeInBand(bool is_bid, uint64_t low, uint64_t high) const
+{
+    if (low > high)
+    {
+        throw std::invalid_argument("Price band low must not exceed high.");
+    }
+
+    DepthCache& cache = depthCache(is_bid);
+    cache.extendToPrice(is_bid ? highest_bid_limit : lowest_ask_limit, is_bid ? low : high);
+
+    // cached levels run from the inside: those inside the band, in it, beyond it
+    const std::vector<DepthLevel>& cached = cache.levels();
+    auto first = std::partition_point(cached.begin(), cached.end(), [&](const DepthLevel& level) {
+        return is_bid ? level.price > high : level.price < low;
+    });
+    auto last = std::partition_point(first, cached.end(), [&](const DepthLevel& level) {
+        return is_bid ? level.price >= low : level.price <= high;
+    });
+    if (first == last)
+    {
+        return 0;
+    }
+
+    uint64_t excluded = first == cached.begin() ? 0 : std::prev(first)->cumulative_volume;
+    return std::prev(last)->cumulative_volume - excluded;
+}
+
+const std::vector<DepthLevel>& OrderBook::depth(bool is_bid, size_t levels) const
+{
+    DepthCache& cache = depthCache(is_bid);
+    cache.extend(is_bid ? highest_bid_limit : lowest_ask_limit, levels);
+    return cache.levels();
+}
+
+FillEstimate OrderBook::estimateFill(bool is_bid, uint64_t quantity) const
+{
+    // an incoming bid sweeps the asks and vice versa
+    DepthCache& cache = depthCache(!is_bid);
+    cache.extendToVolume(is_bid ? lowest_ask_limit : highest_bid_limit, quantity);
+
+    const std::vector<DepthLevel>& cached = cache.levels();
+    FillEstimate estimate{0, 0, 0};
+    if (quantity == 0 || cached.empty())
+    {
+        return estimate;
+    }
+
+    // first level at which the cumulative volume covers the quantity
+    auto level = std::partition_point(cached.begin(), cached.end(), [&](const DepthLevel& level) {
+        return level.cumulative_volume < quantity;
+    });
+    if (level == cached.end())
+    {
+        const DepthLevel& deepest = cached.back();
+        return FillEstimate{deepest.cumulative_volume, deepest.cumulative_notional, deepest.price};
+    }
+
+    uint64_t volume = 0;
+    uint64_t notional = 0;
+    if (level != cached.begin())
+    {
+        volume = std::prev(level)->cumulative_volume;
+        notional = std::prev(level)->cumulative_notional;
+    }
+    return FillEstimate{quantity, notional + (quantity - volume) * level->price, level->price};
+}
+
+void OrderBook::publishSnapshot()
+{
+    if (publisher == nullptr)
+    {
+        return;
+    }
+
+    publisher->beginSnapshot();
+    for (Limit* limit = highest_bid_limit; limit != nullptr; limit = limit->next)
+    {
+        publisher->addSnapshotLevel(true, limit->price(), limit->visible_volume(), limit->size());
+    }
+    for (Limit* limit = lowest_ask_limit; limit != nullptr; limit = limit->next)
+    {
+        publisher->addSnapshotLevel(false, limit->price(), limit->visible_volume(), limit->size());
+    }
+    publisher->endSnapshot();
+}
+
 
 OrderBook::CompareCallback OrderBook::buildCompareCallback(bool is_bid)
 {
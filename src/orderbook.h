@@ -1,28 +1,115 @@
 #include <memory>
 #include <unordered_map>
 #include <functional>
+#include <vector>
 
 #include "order.h"
+#include "order_pool.h"
 #include "limit.h"
+#include "level_list.h"
+#include "market_data.h"
+#include "allocation.h"
+#include "arena.h"
+#include "statistics.h"
+#include "depth.h"
+#include "trace.h"
 
 
-using std::shared_ptr;
+#ifndef ORDERBOOK_H
+#define ORDERBOOK_H
+
 using std::unordered_map;
 
+/*
+* How an incoming order is allocated across the resting orders of a level.
+*
+* PriceTime fills resting orders strictly in arrival order. ProRata splits the
+* incoming quantity across every order at the level in proportion to its open
+* quantity, handing out any rounding remainder one lot at a time in arrival
+* order.
+*/
+enum class MatchingPolicy {
+    PriceTime,
+    ProRata,
+};
+
+/*
+* Reference a pegged order's price follows. Primary pegs follow the best price
+* on their own side. Mid pegs follow the midpoint, each on its own side of it
+* and never at it, so bid and ask mid pegs never lock.
+*/
+enum class PegType {
+    Primary,
+    Mid,
+};
+
+/*
+* Pegged orders sharing side, reference and offset. The queue's price is the
+* group's effective price (0 while the reference is missing), so repricing a
+* group is one store whatever the number of orders in it.
+*/
+struct PegGroup {
+    bool is_bid;
+    PegType type;
+    int64_t offset;
+    Limit queue;
+};
+
+/* Equilibrium price and the volume that executes there (0 if not crossed) */
+struct AuctionResult {
+    uint64_t price;
+    uint64_t volume;
+};
+
+/* Bytes a book holds for its resting orders, its levels and its id indexes */
+struct MemoryFootprint {
+    size_t orders;
+    size_t levels;
+    size_t indexes;
+
+    size_t total() const { return orders + levels + indexes; };
+};
+
+// orders moved per compaction step and the largest table rehashed in one
+const size_t __COMPACT_STEP__{256};
+const size_t __COMPACT_REHASH_LIMIT__{16384};
+
+/*
+* Orders and open quantity removed by a mass cancel. Volume includes iceberg
+* reserves, hidden is the part of it that was never shown.
+*/
+struct MassCancelResult {
+    uint64_t orders;
+    uint64_t volume;
+    uint64_t hidden;
+};
+
 /*
 * A directory containing levels of bids and asks respectively.
 * Limits are stored via hash maps which themselves contain a linked-list
 * of orders. Find a limit using price and the appropriate limit map.
+* Resting orders are held in an OrderPool with their matching fields in a
+* compact hot table and everything else in a parallel cold table.
 *
 * Direct access to the inside of the book is provided efficient matching.
 */
 class OrderBook {
 public:
-    typedef unordered_map<uint, Limit> LimitMap;
+    typedef std::pair<const uint, Limit> LimitEntry;
+    typedef unordered_map<uint, Limit, std::hash<uint>, std::equal_to<uint>, ArenaAllocator<LimitEntry>> LimitMap;
+    typedef std::pair<const uint64_t, uint32_t> OrderIndexEntry;
+    typedef unordered_map<uint64_t, uint32_t, std::hash<uint64_t>, std::equal_to<uint64_t>, ArenaAllocator<OrderIndexEntry>> OrderIndex;
     typedef std::function<bool(uint64_t, uint64_t)> CompareCallback;
 
     OrderBook();
-    OrderBook(uint tick_size);
+    /*
+     * When an arena is given, orders and limits are allocated from it rather
+     * than the global heap. The arena must outlive the book.
+     */
+    OrderBook(uint tick_size, MatchingPolicy policy=MatchingPolicy::PriceTime, Arena* arena=nullptr);
+
+    OrderBook(const OrderBook& b) = delete;
+    OrderBook& operator=(const OrderBook& b) = delete;
 
     /* Generates compare function based on QuoteType */
     CompareCallback buildCompareCallback(bool is_bid);
@@ -38,32 +125,244 @@ public:
     * Creates an Order using timestamp as the id and adds to limit.
     * An associated Limit is created for the order if it doesn't already exist.
     */
-    Order createOrder(bool is_bid, uint64_t quantity, uint64_t filled_quantity, double price);
+    Order createOrder(bool is_bid, uint64_t quantity, uint64_t filled_quantity, double price, uint64_t owner=0);
+
+    /* As createOrder but with the price already given in level (tick) units */
+    Order createLevelOrder(bool is_bid, uint64_t quantity, uint64_t filled_quantity, uint64_t price, uint64_t owner=0);
+
+    /*
+     * Iceberg order showing at most peak (0 < peak < quantity) at a time, with
+     * the price in level units. Once its shown tranche fills, the next one is
+     * taken from the hidden reserve and the same resting slot is requeued at
+     * the back of its level with the timestamp of the fill, within the same
+     * match if quantity remains. Depth, market data and snapshots show the
+     * shown volume only; auctions and cancels count the reserve too.
+     */
+    Order createIcebergOrder(bool is_bid, uint64_t quantity, uint64_t peak, uint64_t price, uint64_t owner=0);
 
     /*
      * Creates an Order and corresponding limit if necessary.
      * Attempts to fulfill incoming Order before creating limit order.
      * Returns Order id if limit order was created and 0 if fulfilled.
+     * Throws std::invalid_argument, before any matching, if the open
+     * quantity does not fit in 32 bits.
      */
     void addOrder(Order& order);
-    void removeOrder(shared_ptr<Order> order);
-    bool matchOrder(Limit* limit, LimitMap limit_map, Order& order);
+    bool matchOrder(Limit* limit, Order& order);
 
+    /*
+     * Mass cancels run in time proportional to the orders removed: by owner
+     * through the per-owner order list, by side or price range by walking
+     * levels from the inside. Levels left empty are reclaimed and the cancel
+     * is published as one depth update per touched level plus a single
+     * mass-cancel event. Owner and side cancels include pegged orders; price
+     * range cancels cover limit levels only.
+     */
+    MassCancelResult cancelOwnerOrders(uint64_t owner);
+    MassCancelResult cancelSide(bool is_bid);
+    MassCancelResult cancelPriceRange(bool is_bid, uint64_t low, uint64_t high);
+
+    /*
+     * Fills up to quantity against the opposite side at any price and returns
+     * the quantity filled. The remainder is dropped; market orders never rest
+     * and are not accepted in auction mode.
+     */
     uint64_t sendMarketOrder(bool is_bid, uint quantity);
+
+    /*
+     * Fills order against the opposite side at its price or better and drops
+     * the remainder, leaving its fills in order. Nothing fills in auction mode.
+     */
+    void sendImmediateOrder(Order& order);
+
+    /*
+     * Amendments to a single resting order, found by id. Each returns the
+     * quantity affected (0 if the order is not resting) and reclaims the
+     * level if it is left empty. Executions record a trade at the resting
+     * price unless a price is given; a replacement loses time priority.
+     */
     uint64_t sendCancelOrder(uint64_t order_id);
+    uint64_t reduceOrder(uint64_t order_id, uint64_t quantity);
+    uint64_t executeOrder(uint64_t order_id, uint64_t quantity, uint64_t price=0);
+    uint64_t replaceOrder(uint64_t order_id, uint64_t new_id, uint64_t quantity, uint64_t price);
 
     uint64_t inside_bid_price() const;
     uint64_t inside_ask_price() const;
     double inside_bid_quantity() const;
     double inside_ask_quantity() const;
 
+    /*
+     * In auction mode incoming orders rest without matching, so the book may
+     * be crossed until uncross() is called. Leaving auction mode uncrosses the
+     * book first so continuous matching never sees a crossed book.
+     */
+    void setAuctionMode(bool enabled);
+    bool auction_mode() const { return _auction_mode; };
+
+    /*
+     * Equilibrium price maximising executable volume, found from cumulative
+     * depth in a single pass over the crossed levels. Ties are broken by the
+     * smallest bid / ask imbalance and then the lowest price.
+     */
+    AuctionResult indicativeUncross() const;
+
+    /* Executes every crossing order at the equilibrium price in one batch */
+    AuctionResult uncross();
+
+    /*
+     * Trade statistics maintained inside the match loop. The rolling window is
+     * keyed on the created_at time (ms) of the incoming order of each fill.
+     */
+    const TradeSummary& session_statistics() const { return statistics.session(); };
+    TradeSummary rolling_statistics(uint64_t now) const { return statistics.rolling(now); };
+    void resetSession() { statistics.resetSession(); };
+    void setStatisticsWindow(uint64_t window_ms) { statistics = TradeStatistics{window_ms}; };
+
+    /*
+     * Depth and market-impact queries read a per-side cumulative depth cache.
+     * Cached levels stay valid until a level at or inside them changes, so
+     * repeated queries near the top of a busy book are a binary search.
+     */
+    uint64_t depthVolume(bool is_bid, size_t levels) const;
+    uint64_t volumeInBand(bool is_bid, uint64_t low, uint64_t high) const;
+
+    /*
+     * Cached levels of a side from the inside, at least `levels` of them when
+     * the book is that deep. Valid until the book next changes.
+     */
+    const std::vector<DepthLevel>& depth(bool is_bid, size_t levels) const;
+
+    /*
+     * Cost of an incoming order of quantity sweeping the opposite side, with
+     * its average and worst fill price. Quantity is capped by the book depth.
+     */
+    FillEstimate estimateFill(bool is_bid, uint64_t quantity) const;
+
+    /*
+     * Rests a pegged order and returns its id. Offsets are in ticks from the
+     * reference and must be passive (bids <= 0, asks >= 0). Pegged orders are
+     * not displayed: depth and market data cover limit orders only, and the
+     * BBO that pegs follow is the limit-order BBO.
+     *
+     * Priority: at the same price, limit orders fill before pegged orders,
+     * earlier-created groups before later ones, and orders within a group in
+     * arrival order, which repricing keeps. Pegs are repriced after each
+     * operation that moves the BBO, never during a sweep, at O(groups) cost.
+     * Pegs hold their prices in auction mode and take no part in uncrossing.
+     */
+    uint64_t addPeggedOrder(bool is_bid, uint64_t quantity, PegType type, int64_t offset=0, uint64_t owner=0);
+
+    /* Effective price of a peg at the current BBO, 0 if the reference is missing */
+    uint64_t pegPrice(bool is_bid, PegType type, int64_t offset) const;
+
     uint size() const { return _size; };
+    MatchingPolicy policy() const { return _policy; };
+
+    /*
+     * Exact bytes allocated for the book's order pool, its level maps and peg
+     * groups, and its order id and owner indexes, including hash buckets.
+     */
+    MemoryFootprint memory() const;
+
+    /*
+     * Once the footprint exceeds a budget (0 for none), compact() gives memory
+     * back in bounded steps: it moves up to max_moves orders out of the
+     * sparsest pool chunk, freeing the chunk once empty, and then shrinks the
+     * bucket arrays of hash tables left mostly empty. Tables above
+     * __COMPACT_REHASH_LIMIT__ entries are never rehashed, so no step pauses
+     * matching for long. Returns true while there is work left to do, so
+     * callers can run it whenever they are idle.
+     */
+    void setMemoryBudget(size_t bytes) { memory_budget = bytes; };
+    size_t memory_budget_bytes() const { return memory_budget; };
+    bool overBudget() const { return memory_budget != 0 && memory().total() > memory_budget; };
+    bool compact(size_t max_moves=__COMPACT_STEP__);
+
+    /*
+     * Attach a shared-memory publisher which receives a trade event per fill
+     * and a depth event per changed level. Pass nullptr to detach.
+     */
+    void setPublisher(MarketDataPublisher* publisher) { this->publisher = publisher; };
+
+    /* Writes the current levels of both sides to the publisher snapshot */
+    void publishSnapshot();
+
+    /*
+     * Copy-on-write snapshot of the levels, driven by a SnapshotChannel. Once
+     * begun, each level's state is appended to bids or asks the first time it
+     * changes; copySnapshotLevels() copies untouched levels from the inside out,
+     * up to levels of them, and returns true once every level is accounted for.
+     * Levels created after the snapshot began are left out, as are peg queues.
+     */
+    void beginSnapshot(std::vector<MarketDataLevel>& bids, std::vector<MarketDataLevel>& asks, uint32_t epoch);
+    bool copySnapshotLevels(size_t& levels);
 private:
     // use tick size to build exponent for formatting order prices
     uint tick_size;
     double exp;
     uint fill_id{0};
     uint _size{0};
+    MatchingPolicy _policy{MatchingPolicy::PriceTime};
+    Arena* arena{nullptr};
+    bool _auction_mode{false};
+
+    // bytes currently allocated by the level maps and the indexes
+    size_t level_bytes{0};
+    size_t index_bytes{0};
+    size_t memory_budget{0};
+
+    OrderPool orders;
+
+    // pool slot of every resting order by id
+    OrderIndex order_ids;
+
+    /* Level or peg group queue holding a resting order */
+    Limit& restingLimit(uint32_t order);
+
+    /* Moves a resting order to another pool slot and relinks everything pointing at it */
+    void relocateOrder(uint32_t order);
+
+    std::vector<PegGroup> peg_groups;
+    // BBO the pegs were last priced at
+    uint64_t peg_bid{0};
+    uint64_t peg_ask{0};
+
+    /* Best active peg group on a side that crosses order, or nullptr */
+    PegGroup* bestPegGroup(bool is_bid, const Order& order);
+    void repricePegs();
+
+    /* Takes up to quantity off a resting order and reclaims an emptied level */
+    uint64_t reduceResting(uint32_t order, uint64_t quantity);
+
+    /* Adds the open quantity of order to its limit without matching */
+    void restOrder(Order& order);
+
+    /* Unlinks a resting order from its limit and owner and frees its slot */
+    void removeOrder(Limit& limit, uint32_t order);
+
+    /* Drops empty limits from the front of a side after a batch of fills */
+    void releaseEmptyLimits(bool is_bid);
+
+    /* Unlinks a limit from its side and erases it from the limit map */
+    void eraseLimit(Limit& limit, bool is_bid);
+
+    // head of the intrusive list of resting orders per owner (owner 0 is untracked)
+    OrderIndex owner_orders;
+    void linkOwner(uint32_t order);
+    void unlinkOwner(uint32_t order);
+
+    void cancelLevels(bool is_bid, uint64_t low, uint64_t high, std::vector<std::pair<bool, uint64_t>>& touched, MassCancelResult& result);
+    void cancelResting(uint32_t order, std::vector<std::pair<bool, uint64_t>>& touched, MassCancelResult& result);
+    void finishMassCancel(std::vector<std::pair<bool, uint64_t>>& touched, MassCancelResult& result, uint64_t owner);
+
+    /* Fills order against a single level using the book matching policy */
+    void matchLevel(Limit& limit, Order& order);
+    void matchPriceTime(Limit& limit, Order& order);
+    void matchProRata(Limit& limit, Order& order);
+
+    // scratch space reused by pro-rata allocation
+    std::vector<double> level_quantities;
+    std::vector<double> level_allocations;
 
     /* Creates Limit and updates lowest ask / highest bid */
     Limit& createBidLimit(uint64_t price);
@@ -77,6 +376,30 @@ private:
     Limit* lowest_ask_limit{nullptr};
     Limit* highest_bid_limit{nullptr};
 
+    MarketDataPublisher* publisher{nullptr};
+
+    // destination of preserved levels while a snapshot is being taken
+    std::vector<MarketDataLevel>* snapshot_bids{nullptr};
+    std::vector<MarketDataLevel>* snapshot_asks{nullptr};
+    uint32_t snapshot_epoch{0};
+    Limit* snapshot_cursor{nullptr};
+    bool snapshot_cursor_bid{true};
+
+    /* Preserves a level's state before its first change in a snapshot */
+    void preserveLevel(Limit& limit, bool is_bid);
+
+    /* Invalidates cached depth from the level outward and publishes it */
+    void levelChanged(const Limit& limit, bool is_bid);
+
+    mutable DepthCache bid_depth{true};
+    mutable DepthCache ask_depth{false};
+    DepthCache& depthCache(bool is_bid) const { return is_bid ? bid_depth : ask_depth; };
+
+    TradeStatistics statistics;
+
+    /* Updates statistics and publishes a trade event for a single fill */
+    void recordTrade(uint64_t price, uint64_t quantity, bool is_bid, uint64_t maker_id, uint64_t taker_id, uint64_t timestamp);
+
     // start order ids at 1 and reserve 0 for instances where no order created
     uint64_t next_id{1};
 
@@ -87,3 +410,5 @@ private:
 uint64_t getTimestamp();
 
 std::ostream& operator<<(std::ostream& os, const OrderBook& l);
+
+#endif
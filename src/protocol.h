@@ -0,0 +1,51 @@
+#include <cstdint>
+
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+/*
+* Fixed-length binary order-entry protocol.
+*
+* Every message is 32 bytes in host (little-endian) byte order so a receive
+* buffer can be decoded in place by casting each 32-byte chunk. Prices are
+* given in level (tick) units, i.e. already formatted by the book tick size.
+*/
+enum class MessageType : uint8_t {
+    NewOrder = 1,
+    Ack = 2,
+    Reject = 3,
+};
+
+enum class RejectReason : uint8_t {
+    None = 0,
+    UnknownType = 1,
+    InvalidOrder = 2,
+};
+
+struct OrderMessage {
+    MessageType type;
+    bool is_bid;
+    uint16_t reserved;
+    uint32_t quantity;
+    // opaque client tag echoed back in the ack
+    uint64_t client_id;
+    uint64_t price;
+    // client send time echoed back for round-trip measurement
+    uint64_t sent_at;
+};
+
+struct AckMessage {
+    MessageType type;
+    RejectReason reason;
+    uint16_t reserved;
+    uint32_t filled_quantity;
+    uint64_t client_id;
+    uint64_t order_id;
+    uint64_t sent_at;
+};
+
+static_assert(sizeof(OrderMessage) == 32, "OrderMessage must be 32 bytes");
+static_assert(sizeof(AckMessage) == 32, "AckMessage must be 32 bytes");
+
+#endif
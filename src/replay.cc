@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#include "replay.h"
+
+
+const uint64_t __FNV_OFFSET__{14695981039346656037ull};
+const uint64_t __FNV_PRIME__{1099511628211ull};
+
+static void hashValue(uint64_t& hash, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        hash = (hash ^ ((value >> (i * 8)) & 0xff)) * __FNV_PRIME__;
+    }
+}
+
+ReplayEngine::ReplayEngine(size_t threads)
+    :threads{threads}
+{
+    if (threads == 0)
+    {
+        throw std::invalid_argument("Replay needs at least one worker thread.");
+    }
+}
+
+void ReplayEngine::setSnapshots(SnapshotCoordinator* snapshots)
+{
+    if (snapshots != nullptr && snapshots->shards() != threads)
+    {
+        throw std::invalid_argument("Snapshots need one shard per replay worker.");
+    }
+    this->snapshots = snapshots;
+}
+
+ReplayResult ReplayEngine::run(const std::string& path)
+{
+    ItchFile file{path};
+    return run(file.data(), file.size());
+}
+
+ReplayResult ReplayEngine::run(const uint8_t* data, size_t size)
+{
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t i = 0; i < threads; i++)
+    {
+        workers.push_back(std::make_unique<Worker>());
+        workers.back()->queue = std::make_unique<SPSCQueue<SequencedMessage, __REPLAY_QUEUE_SIZE__>>();
+        if (snapshots != nullptr)
+            workers.back()->snapshots = &snapshots->channel(i);
+    }
+
+    decoded.store(false, std::memory_order_relaxed);
+    for (auto& worker : workers)
+    {
+        worker->thread = std::thread{&ReplayEngine::work, this, std::ref(*worker)};
+    }
+
+    ReplayResult result{0, 0, 0, __FNV_OFFSET__, {}};
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        size_t offset = 0;
+        const uint8_t* body;
+        uint16_t length;
+        ItchMessage message;
+        while (nextItchMessage(data, size, offset, body, length))
+        {
+            result.messages++;
+            if (!decodeItchMessage(body, length, message))
+                continue;
+
+            result.applied++;
+            Worker& worker = *workers[message.stock_locate % threads];
+            while (!worker.queue->push(SequencedMessage{result.messages, message}))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    catch (...)
+    {
+        decoded.store(true, std::memory_order_release);
+        for (auto& worker : workers)
+            worker->thread.join();
+        throw;
+    }
+
+    decoded.store(true, std::memory_order_release);
+    for (auto& worker : workers)
+    {
+        worker->thread.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    result.seconds = std::chrono::duration<double>(end - start).count();
+
+    for (auto& worker : workers)
+    {
+        for (auto& [stock_locate, book] : worker->books)
+        {
+            result.symbols.push_back(summarise(stock_locate, book));
+        }
+    }
+    std::sort(result.symbols.begin(), result.symbols.end(), [](const SymbolSummary& a, const SymbolSummary& b) {
+        return a.stock_locate < b.stock_locate;
+    });
+
+    for (const SymbolSummary& symbol : result.symbols)
+    {
+        hashValue(result.checksum, symbol.stock_locate);
+        hashValue(result.checksum, symbol.messages);
+        hashValue(result.checksum, symbol.orders);
+        hashValue(result.checksum, symbol.bid_price);
+        hashValue(result.checksum, symbol.bid_volume);
+        hashValue(result.checksum, symbol.ask_price);
+        hashValue(result.checksum, symbol.ask_volume);
+        hashValue(result.checksum, symbol.traded_volume);
+        hashValue(result.checksum, symbol.trade_count);
+    }
+    return result;
+}
+
+void ReplayEngine::work(Worker& worker)
+{
+    SequencedMessage message;
+    while (true)
+    {
+        if (worker.queue->pop(message))
+        {
+            apply(worker, message);
+            continue;
+        }
+
+        // the decoder is done once the flag is set, so drain and exit
+        if (decoded.load(std::memory_order_acquire))
+        {
+            while (worker.queue->pop(message))
+                apply(worker, message);
+            if (worker.snapshots != nullptr)
+            {
+                // the worker's books do not outlive the run
+                worker.snapshots->flush();
+                worker.snapshots->clearBooks();
+            }
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void ReplayEngine::apply(Worker& worker, const SequencedMessage& sequenced)
+{
+    if (worker.snapshots != nullptr)
+    {
+        worker.snapshots->advance(sequenced.sequence);
+    }
+
+    const ItchMessage& message = sequenced.message;
+    SymbolBook& symbol = worker.books[message.stock_locate];
+    if (symbol.book == nullptr)
+    {
+        // ITCH prices carry 4 implied decimals, so levels are the raw price
+        symbol.book = std::make_unique<OrderBook>(0);
+        if (worker.snapshots != nullptr)
+            worker.snapshots->addBook(message.stock_locate, *symbol.book);
+    }
+    symbol.messages++;
+
+    OrderBook& book = *symbol.book;
+    switch (message.type)
+    {
+        case ItchMessageType::StockDirectory:
+            symbol.symbol = itchSymbol(message);
+            break;
+        case ItchMessageType::AddOrder:
+        case ItchMessageType::AddOrderMPID:
+        {
+            if (symbol.symbol.empty())
+                symbol.symbol = itchSymbol(message);
+
+            // created_at is kept in ms, ITCH timestamps are ns since midnight
+            Order order{message.order_ref, message.timestamp / 1000000, message.is_bid, message.shares, 0, message.price};
+            book.addOrder(order);
+            break;
+        }
+        case ItchMessageType::OrderExecuted:
+            book.executeOrder(message.order_ref, message.shares);
+            break;
+        case ItchMessageType::OrderExecutedWithPrice:
+            book.executeOrder(message.order_ref, message.shares, message.price);
+            break;
+        case ItchMessageType::OrderCancel:
+            book.reduceOrder(message.order_ref, message.shares);
+            break;
+        case ItchMessageType::OrderDelete:
+            book.sendCancelOrder(message.order_ref);
+            break;
+        case ItchMessageType::OrderReplace:
+            book.replaceOrder(message.order_ref, message.new_order_ref, message.shares, message.price);
+            break;
+    }
+}
+
+SymbolSummary ReplayEngine::summarise(uint16_t stock_locate, SymbolBook& symbol)
+{
+    OrderBook& book = *symbol.book;
+    const TradeSummary& trades = book.session_statistics();
+    return SymbolSummary{
+        stock_locate,
+        symbol.symbol,
+        symbol.messages,
+        book.size(),
+        book.inside_bid_price(),
+        book.depthVolume(true, 1),
+        book.inside_ask_price(),
+        book.depthVolume(false, 1),
+        trades.volume,
+        trades.trade_count
+    };
+}
+
+
+std::vector<uint8_t> generateItchMessages(size_t messages, uint16_t symbols, uint64_t seed)
+{
+    struct LiveOrder {
+        uint64_t ref;
+        uint16_t stock_locate;
+        bool is_bid;
+        uint32_t shares;
+    };
+
+    std::mt19937_64 gen{seed};
+    std::uniform_int_distribution<uint16_t> symbol(1, std::max<uint16_t>(symbols, 1));
+    std::uniform_int_distribution<uint32_t> ticks(1, 50);
+    std::uniform_int_distribution<uint32_t> lots(1, 10);
+    std::uniform_int_distribution<int> action(0, 99);
+
+    std::vector<uint8_t> out;
+    std::vector<LiveOrder> live;
+    uint64_t next_ref = 1;
+    uint64_t timestamp = 0;
+
+    auto message = [&](ItchMessageType type, uint16_t stock_locate) {
+        ItchMessage m;
+        std::memset(&m, 0, sizeof(m));
+        m.type = type;
+        m.stock_locate = stock_locate;
+        m.timestamp = timestamp += 1000;
+        return m;
+    };
+    // bids rest below and asks above a mid of 100.0000, so the feed never crosses
+    auto price = [&](bool is_bid) {
+        return is_bid ? 1000000 - ticks(gen) * 100 : 1000000 + ticks(gen) * 100;
+    };
+
+    for (uint16_t i = 1; i <= symbols; i++)
+    {
+        ItchMessage m = message(ItchMessageType::StockDirectory, i);
+        std::string name = "SYM" + std::to_string(i);
+        std::memset(m.symbol, ' ', __ITCH_SYMBOL_LENGTH__);
+        std::memcpy(m.symbol, name.data(), std::min(name.size(), __ITCH_SYMBOL_LENGTH__));
+        encodeItchMessage(m, out);
+    }
+
+    for (size_t n = symbols; n < messages; n++)
+    {
+        int roll = action(gen);
+        if (live.empty() || roll < 50)
+        {
+            ItchMessage m = message(ItchMessageType::AddOrder, symbol(gen));
+            m.order_ref = next_ref++;
+            m.is_bid = roll % 2 == 0;
+            m.shares = lots(gen) * 100;
+            m.price = price(m.is_bid);
+            std::string name = "SYM" + std::to_string(m.stock_locate);
+            std::memset(m.symbol, ' ', __ITCH_SYMBOL_LENGTH__);
+            std::memcpy(m.symbol, name.data(), std::min(name.size(), __ITCH_SYMBOL_LENGTH__));
+            encodeItchMessage(m, out);
+            live.push_back(LiveOrder{m.order_ref, m.stock_locate, m.is_bid, m.shares});
+            continue;
+        }
+
+        size_t index = gen() % live.size();
+        LiveOrder& order = live[index];
+        ItchMessage m;
+        if (roll < 80)
+        {
+            // execute or cancel part of the order, possibly all of it
+            m = message(roll < 65 ? ItchMessageType::OrderExecuted : ItchMessageType::OrderCancel, order.stock_locate);
+            m.order_ref = order.ref;
+            m.shares = std::min(order.shares, lots(gen) * 100);
+            order.shares -= m.shares;
+        }
+        else if (roll < 90) {
+            m = message(ItchMessageType::OrderDelete, order.stock_locate);
+            m.order_ref = order.ref;
+            order.shares = 0;
+        }
+        else {
+            m = message(ItchMessageType::OrderReplace, order.stock_locate);
+            m.order_ref = order.ref;
+            m.new_order_ref = next_ref++;
+            m.shares = lots(gen) * 100;
+            m.price = price(order.is_bid);
+            order.ref = m.new_order_ref;
+            order.shares = m.shares;
+        }
+        encodeItchMessage(m, out);
+
+        if (order.shares == 0)
+        {
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+    return out;
+}
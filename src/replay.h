@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "orderbook.h"
+#include "itch.h"
+#include "spsc_queue.h"
+#include "snapshot.h"
+
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+const size_t __REPLAY_QUEUE_SIZE__{1 << 16};
+
+/* Final state of one symbol's book after a replay */
+struct SymbolSummary {
+    uint16_t stock_locate;
+    std::string symbol;
+    uint64_t messages;
+    uint orders;
+    uint64_t bid_price;
+    uint64_t bid_volume;
+    uint64_t ask_price;
+    uint64_t ask_volume;
+    uint64_t traded_volume;
+    uint64_t trade_count;
+};
+
+struct ReplayResult {
+    uint64_t messages;
+    uint64_t applied;
+    double seconds;
+    // FNV-1a over every symbol summary in stock locate order
+    uint64_t checksum;
+    std::vector<SymbolSummary> symbols;
+
+    double messages_per_second() const { return seconds == 0 ? 0 : messages / seconds; };
+};
+
+/*
+* Replays an ITCH 5.0 binary file into one OrderBook per symbol.
+*
+* The calling thread walks the mapped file once, decoding each message and
+* routing book messages by stock locate to a fixed worker, so every symbol's
+* messages are applied in file order by a single thread. Workers own their
+* books outright and drain a lock-free queue each. The checksum only depends
+* on the file, not on the number of workers.
+*
+* With a SnapshotCoordinator attached, each worker is a snapshot shard and
+* messages are sequenced by their position in the file, starting at 1.
+*/
+class ReplayEngine {
+public:
+    ReplayEngine(size_t threads=std::max(1u, std::thread::hardware_concurrency()));
+
+    ReplayResult run(const std::string& path);
+    ReplayResult run(const uint8_t* data, size_t size);
+
+    /* Needs one shard per worker and must outlive every run; nullptr detaches */
+    void setSnapshots(SnapshotCoordinator* snapshots);
+
+private:
+    struct SequencedMessage {
+        uint64_t sequence;
+        ItchMessage message;
+    };
+
+    struct SymbolBook {
+        std::string symbol;
+        uint64_t messages{0};
+        std::unique_ptr<OrderBook> book;
+    };
+
+    struct Worker {
+        std::unique_ptr<SPSCQueue<SequencedMessage, __REPLAY_QUEUE_SIZE__>> queue;
+        std::unordered_map<uint16_t, SymbolBook> books;
+        SnapshotChannel* snapshots{nullptr};
+        std::thread thread;
+    };
+
+    size_t threads;
+    std::atomic<bool> decoded{false};
+    SnapshotCoordinator* snapshots{nullptr};
+
+    void work(Worker& worker);
+    void apply(Worker& worker, const SequencedMessage& sequenced);
+    SymbolSummary summarise(uint16_t stock_locate, SymbolBook& book);
+};
+
+/*
+* Generates a reproducible ITCH stream over a number of symbols: a directory
+* entry per symbol, then uncrossed adds with executions, partial cancels,
+* deletes and replaces of live orders.
+*/
+std::vector<uint8_t> generateItchMessages(size_t messages, uint16_t symbols, uint64_t seed=1337);
+
+#endif
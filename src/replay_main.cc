@@ -0,0 +1,58 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#include "orderbook.h"
+#include "replay.h"
+
+
+#define __GENERATED_MESSAGES__ 1000000
+#define __GENERATED_SYMBOLS__ 64
+
+/*
+* Usage: replay <file> [threads]
+*        replay --generate <file> [messages] [symbols]
+*
+* Replays an ITCH 5.0 binary file, one OrderBook per symbol, and reports
+* throughput, the final state of every symbol and a checksum to compare runs.
+* --generate writes a synthetic file to replay.
+*/
+int main(int argc, const char* argv[])
+{
+    if (argc > 2 && std::strcmp(argv[1], "--generate") == 0)
+    {
+        size_t messages = argc > 3 ? std::atoll(argv[3]) : __GENERATED_MESSAGES__;
+        uint16_t symbols = argc > 4 ? std::atoi(argv[4]) : __GENERATED_SYMBOLS__;
+        std::vector<uint8_t> data = generateItchMessages(messages, symbols);
+        std::ofstream file{argv[2], std::ios::binary};
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        std::cout << "Wrote " << messages << " messages over " << symbols << " symbols to " << argv[2] << "\n";
+        return 0;
+    }
+
+    if (argc < 2)
+    {
+        std::cerr << "Usage: replay <file> [threads] | replay --generate <file> [messages] [symbols]\n";
+        return 1;
+    }
+
+    size_t threads = argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    ReplayEngine engine{threads};
+    ReplayResult result = engine.run(argv[1]);
+
+    for (const SymbolSummary& symbol : result.symbols)
+    {
+        std::cout << std::setw(8) << std::left << symbol.symbol << std::right
+            << " locate: " << symbol.stock_locate
+            << " messages: " << symbol.messages
+            << " orders: " << symbol.orders
+            << " bid: " << symbol.bid_volume << "@" << symbol.bid_price
+            << " ask: " << symbol.ask_volume << "@" << symbol.ask_price
+            << " traded: " << symbol.traded_volume << " in " << symbol.trade_count << "\n";
+    }
+    std::cout << "Messages: " << result.messages << " (applied " << result.applied << ") on " << threads << " threads \n";
+    std::cout << "Time: " << result.seconds << "s, throughput: " << (uint64_t)result.messages_per_second() << " msg/s \n";
+    std::cout << "Checksum: " << std::hex << std::setw(16) << std::setfill('0') << result.checksum << std::dec << "\n";
+    return 0;
+}
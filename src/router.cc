@@ -0,0 +1,140 @@
+#include "router.h"
+
+
+size_t ConsolidatedBook::addBook(OrderBook& book)
+{
+    _books.push_back(&book);
+    bids.position.push_back(__NO_BOOK__);
+    asks.position.push_back(__NO_BOOK__);
+    refresh(_books.size() - 1);
+    return _books.size() - 1;
+}
+
+void ConsolidatedBook::refresh(size_t book)
+{
+    const OrderBook& orderbook = *_books[book];
+    bool matching = !orderbook.auction_mode();
+    update(bids, book, matching ? orderbook.inside_bid_price() : 0);
+    update(asks, book, matching ? orderbook.inside_ask_price() : 0);
+}
+
+void ConsolidatedBook::addOrder(size_t book, Order& order)
+{
+    _books[book]->addOrder(order);
+    refresh(book);
+}
+
+uint64_t ConsolidatedBook::sendCancelOrder(size_t book, uint64_t order_id)
+{
+    uint64_t cancelled = _books[book]->sendCancelOrder(order_id);
+    refresh(book);
+    return cancelled;
+}
+
+RouteResult ConsolidatedBook::route(bool is_bid, uint64_t quantity, uint64_t price, uint64_t owner)
+{
+    RouteResult result{0, 0, {}};
+    Side& side = is_bid ? asks : bids;
+    while (result.filled_quantity < quantity && !side.heap.empty())
+    {
+        HeapEntry best = side.heap.front();
+        if (is_bid ? best.price > price : best.price < price)
+            break;
+
+        // take the best level of the best book; the heap then yields the next
+        OrderBook& book = *_books[best.book];
+        Order order = book.createLevelOrder(is_bid, quantity - result.filled_quantity, 0, best.price, owner);
+        book.sendImmediateOrder(order);
+        refresh(best.book);
+
+        if (order.filled_quantity() == 0)
+            break;
+        result.fills.push_back(RouteFill{best.book, best.price, order.filled_quantity(), order.filled_cost()});
+        result.filled_quantity += order.filled_quantity();
+        result.filled_cost += order.filled_cost();
+    }
+    return result;
+}
+
+size_t ConsolidatedBook::inside_book(bool is_bid) const
+{
+    const Side& side = is_bid ? bids : asks;
+    return side.heap.empty() ? __NO_BOOK__ : side.heap.front().book;
+}
+
+
+void ConsolidatedBook::update(Side& side, size_t book, uint64_t price)
+{
+    size_t index = side.position[book];
+    if (index == __NO_BOOK__)
+    {
+        if (price == 0)
+            return;
+        side.heap.push_back(HeapEntry{price, book});
+        side.position[book] = side.heap.size() - 1;
+        siftUp(side, side.heap.size() - 1);
+        return;
+    }
+
+    if (price == 0)
+    {
+        // move the last entry into the hole and restore the heap around it
+        side.position[book] = __NO_BOOK__;
+        HeapEntry last = side.heap.back();
+        side.heap.pop_back();
+        if (index == side.heap.size())
+            return;
+        place(side, index, last);
+    }
+    else {
+        side.heap[index].price = price;
+    }
+    // the entry at index moves one way only
+    size_t moved = side.heap[index].book;
+    siftUp(side, index);
+    siftDown(side, side.position[moved]);
+}
+
+bool ConsolidatedBook::better(const Side& side, const HeapEntry& a, const HeapEntry& b) const
+{
+    if (a.price != b.price)
+        return side.is_bid ? a.price > b.price : a.price < b.price;
+    return a.book < b.book;
+}
+
+void ConsolidatedBook::place(Side& side, size_t index, const HeapEntry& entry)
+{
+    side.heap[index] = entry;
+    side.position[entry.book] = index;
+}
+
+void ConsolidatedBook::siftUp(Side& side, size_t index)
+{
+    HeapEntry entry = side.heap[index];
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / 2;
+        if (!better(side, entry, side.heap[parent]))
+            break;
+        place(side, index, side.heap[parent]);
+        index = parent;
+    }
+    place(side, index, entry);
+}
+
+void ConsolidatedBook::siftDown(Side& side, size_t index)
+{
+    HeapEntry entry = side.heap[index];
+    size_t size = side.heap.size();
+    while (2 * index + 1 < size)
+    {
+        size_t child = 2 * index + 1;
+        if (child + 1 < size && better(side, side.heap[child + 1], side.heap[child]))
+            child++;
+        if (!better(side, side.heap[child], entry))
+            break;
+        place(side, index, side.heap[child]);
+        index = child;
+    }
+    place(side, index, entry);
+}
@@ -0,0 +1,107 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "orderbook.h"
+
+
+#ifndef ROUTER_H
+#define ROUTER_H
+
+// book index returned when a side of every book is empty
+const size_t __NO_BOOK__{SIZE_MAX};
+
+/*
+* Fills taken from one book in one routing step. Price is the limit level the
+* step was routed to; pegged orders inside the spread may fill first at better
+* prices, so cost / quantity is the step's actual average price.
+*/
+struct RouteFill {
+    size_t book;
+    uint64_t price;
+    uint64_t quantity;
+    uint64_t cost;
+};
+
+/* Consolidated fills of a routed order, in the order they were taken */
+struct RouteResult {
+    uint64_t filled_quantity;
+    uint64_t filled_cost;
+    std::vector<RouteFill> fills;
+};
+
+/*
+* Consolidated view of several OrderBooks trading the same instrument with
+* the same tick size, e.g. a lit, a dark and an auction book.
+*
+* The best bid and ask of every book are kept in one indexed binary heap per
+* side, ordered by price and then by the order the books were added. A change
+* to one book moves only its own entries, so the consolidated BBO is read in
+* O(1) and kept current in O(log books). Books in auction mode do not match
+* and are left out until they leave it.
+*
+* Changes made through the router refresh the book they touch; changes made
+* to a book directly must be followed by refresh(book).
+*/
+class ConsolidatedBook {
+public:
+    ConsolidatedBook() = default;
+
+    ConsolidatedBook(const ConsolidatedBook& b) = delete;
+    ConsolidatedBook& operator=(const ConsolidatedBook& b) = delete;
+
+    /* Adds a book to the view and returns its index */
+    size_t addBook(OrderBook& book);
+    OrderBook& book(size_t book) const { return *_books[book]; };
+    size_t books() const { return _books.size(); };
+
+    /* Re-reads the BBO of a book after it changed outside the router */
+    void refresh(size_t book);
+
+    /* Adds an order to one book, matching it there only */
+    void addOrder(size_t book, Order& order);
+    uint64_t sendCancelOrder(size_t book, uint64_t order_id);
+
+    /*
+    * Sweeps up to quantity at price or better across every book in price
+    * priority, one level of one book per step, and drops the remainder.
+    * Books at the same price are taken in the order they were added. Each
+    * step is an immediate order at the level's price on that book, so it
+    * matches there under the book's own policy.
+    */
+    RouteResult route(bool is_bid, uint64_t quantity, uint64_t price, uint64_t owner=0);
+    RouteResult sendMarketOrder(bool is_bid, uint64_t quantity) { return route(is_bid, quantity, is_bid ? UINT64_MAX : 0); };
+
+    /* Consolidated BBO, 0 if the side is empty in every book */
+    uint64_t inside_bid_price() const { return bids.heap.empty() ? 0 : bids.heap.front().price; };
+    uint64_t inside_ask_price() const { return asks.heap.empty() ? 0 : asks.heap.front().price; };
+
+    /* Book holding the consolidated best price of a side, or __NO_BOOK__ */
+    size_t inside_book(bool is_bid) const;
+
+private:
+    struct HeapEntry {
+        uint64_t price;
+        size_t book;
+    };
+
+    struct Side {
+        bool is_bid;
+        std::vector<HeapEntry> heap{};
+        // heap index of each book's entry, __NO_BOOK__ if it has none
+        std::vector<size_t> position{};
+    };
+
+    std::vector<OrderBook*> _books;
+    Side bids{true};
+    Side asks{false};
+
+    /* Sets a book's price on a side, removing its entry when price is 0 */
+    void update(Side& side, size_t book, uint64_t price);
+    bool better(const Side& side, const HeapEntry& a, const HeapEntry& b) const;
+    void place(Side& side, size_t index, const HeapEntry& entry);
+    void siftUp(Side& side, size_t index);
+    void siftDown(Side& side, size_t index);
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "snapshot.h"
+
+
+SnapshotChannel::SnapshotChannel(SnapshotCoordinator& coordinator, size_t step)
+    :coordinator{coordinator},
+    step{std::max<size_t>(step, 1)}
+{}
+
+void SnapshotChannel::addBook(uint64_t id, OrderBook& book)
+{
+    // a book added mid-snapshot did not exist at the snapshot point
+    books.push_back({id, &book});
+}
+
+void SnapshotChannel::advance(uint64_t sequence)
+{
+    if (!active)
+    {
+        uint32_t epoch = coordinator.epoch.load(std::memory_order_acquire);
+        if (epoch == seen_epoch || sequence <= coordinator.sequence.load(std::memory_order_relaxed))
+        {
+            last_sequence = sequence;
+            return;
+        }
+        begin(epoch);
+    }
+
+    last_sequence = sequence;
+    copyLevels(step);
+}
+
+void SnapshotChannel::flush()
+{
+    uint32_t epoch = coordinator.epoch.load(std::memory_order_acquire);
+    if (!active && epoch != seen_epoch)
+    {
+        begin(epoch);
+    }
+    if (active)
+    {
+        copyLevels(SIZE_MAX);
+    }
+}
+
+void SnapshotChannel::begin(uint32_t epoch)
+{
+    seen_epoch = epoch;
+    active = true;
+    late = last_sequence > coordinator.sequence.load(std::memory_order_relaxed);
+
+    // vectors stay put for the whole snapshot since books write into them
+    snapshot_books = books.size();
+    cursor = 0;
+    snapshots.resize(snapshot_books);
+    for (size_t i = 0; i < snapshot_books; i++)
+    {
+        snapshots[i].book = books[i].first;
+        books[i].second->beginSnapshot(snapshots[i].bids, snapshots[i].asks, epoch);
+    }
+}
+
+void SnapshotChannel::copyLevels(size_t levels)
+{
+    while (cursor < snapshot_books)
+    {
+        if (!books[cursor].second->copySnapshotLevels(levels))
+            return;
+        cursor++;
+    }
+
+    active = false;
+    coordinator.shardDone();
+}
+
+
+SnapshotCoordinator::SnapshotCoordinator(size_t shards, size_t step)
+{
+    if (shards == 0)
+    {
+        throw std::invalid_argument("Snapshots need at least one shard.");
+    }
+    for (size_t i = 0; i < shards; i++)
+    {
+        channels.push_back(std::make_unique<SnapshotChannel>(*this, step));
+    }
+    materialiser = std::thread{&SnapshotCoordinator::materialise, this};
+}
+
+SnapshotCoordinator::~SnapshotCoordinator()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    changed.notify_all();
+    materialiser.join();
+}
+
+bool SnapshotCoordinator::request(uint64_t sequence)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    if (in_flight || ready)
+    {
+        return false;
+    }
+
+    in_flight = true;
+    shards_done = 0;
+    this->sequence.store(sequence, std::memory_order_relaxed);
+    epoch.store(epoch.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return true;
+}
+
+ConsistentSnapshot SnapshotCoordinator::wait()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    if (!in_flight && !ready)
+    {
+        throw std::logic_error("No snapshot has been requested.");
+    }
+    changed.wait(lock, [this] { return ready; });
+
+    ready = false;
+    return std::move(result);
+}
+
+void SnapshotCoordinator::shardDone()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        shards_done++;
+    }
+    changed.notify_all();
+}
+
+void SnapshotCoordinator::materialise()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            changed.wait(lock, [this] { return stopping || (in_flight && shards_done == channels.size()); });
+            if (stopping)
+                return;
+        }
+
+        // every shard has handed over, so nothing writes to the channels until
+        // the next request, which waits for this one to be collected
+        ConsistentSnapshot snapshot{sequence.load(std::memory_order_relaxed), false, {}};
+        for (auto& channel : channels)
+        {
+            snapshot.late = snapshot.late || channel->late;
+            for (BookSnapshot& book : channel->snapshots)
+            {
+                std::sort(book.bids.begin(), book.bids.end(), [](const MarketDataLevel& a, const MarketDataLevel& b) {
+                    return a.price > b.price;
+                });
+                std::sort(book.asks.begin(), book.asks.end(), [](const MarketDataLevel& a, const MarketDataLevel& b) {
+                    return a.price < b.price;
+                });
+                snapshot.books.push_back(std::move(book));
+            }
+            channel->snapshots.clear();
+        }
+        std::sort(snapshot.books.begin(), snapshot.books.end(), [](const BookSnapshot& a, const BookSnapshot& b) {
+            return a.book < b.book;
+        });
+
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            result = std::move(snapshot);
+            in_flight = false;
+            ready = true;
+        }
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "orderbook.h"
+#include "market_data.h"
+
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// levels a shard copies per message while a snapshot is being taken
+const size_t __SNAPSHOT_STEP_LEVELS__{8};
+
+/* Levels of one book at the snapshot point, sorted from the inside out */
+struct BookSnapshot {
+    uint64_t book;
+    std::vector<MarketDataLevel> bids;
+    std::vector<MarketDataLevel> asks;
+};
+
+/*
+* Point-in-time view of every book across all shards: each book as it stood
+* after the last of its messages with a sequence at or below sequence. late is
+* set when a shard had already passed the sequence when the request reached
+* it, in which case its books show a later point.
+*/
+struct ConsistentSnapshot {
+    uint64_t sequence;
+    bool late;
+    // sorted by book id
+    std::vector<BookSnapshot> books;
+};
+
+class SnapshotCoordinator;
+
+/*
+* A shard's side of the snapshot protocol, used only by the shard's matching
+* thread. Books are registered once and must outlive the channel.
+*
+* The shard calls advance() with each message's sequence before applying it.
+* Past the requested sequence, every registered book starts preserving the old
+* state of each level on its first change (copy-on-write), while advance()
+* copies up to step levels that are still untouched. The per-message overhead
+* is bounded by step plus the levels the message changes itself.
+*/
+class SnapshotChannel {
+public:
+    SnapshotChannel(SnapshotCoordinator& coordinator, size_t step);
+
+    SnapshotChannel(const SnapshotChannel& c) = delete;
+    SnapshotChannel& operator=(const SnapshotChannel& c) = delete;
+
+    void addBook(uint64_t id, OrderBook& book);
+
+    void advance(uint64_t sequence);
+
+    /*
+     * Completes any requested snapshot as if every later message had arrived.
+     * Call once the shard has no more messages, or a request can only finish
+     * when the shard's next message arrives.
+     */
+    void flush();
+
+    /* Unregisters every book, once flushed, so they can be destroyed */
+    void clearBooks() { books.clear(); };
+
+private:
+    friend class SnapshotCoordinator;
+
+    SnapshotCoordinator& coordinator;
+    size_t step;
+    std::vector<std::pair<uint64_t, OrderBook*>> books;
+
+    uint32_t seen_epoch{0};
+    bool active{false};
+    bool late{false};
+    uint64_t last_sequence{0};
+    // books registered when the snapshot began and the next one to copy
+    size_t snapshot_books{0};
+    size_t cursor{0};
+    std::vector<BookSnapshot> snapshots;
+
+    void begin(uint32_t epoch);
+    void copyLevels(size_t levels);
+};
+
+/*
+* Takes consistent snapshots across books owned by many matching threads
+* without pausing them.
+*
+* A reader requests a sequence number. Each shard switches its books into
+* copy-on-write mode as it passes that sequence and hands the preserved levels
+* over once every level is accounted for. A background thread then sorts them
+* into the final snapshot, so matching threads only ever copy levels. One
+* snapshot may be in flight at a time.
+*/
+class SnapshotCoordinator {
+public:
+    SnapshotCoordinator(size_t shards, size_t step=__SNAPSHOT_STEP_LEVELS__);
+
+    SnapshotCoordinator(const SnapshotCoordinator& c) = delete;
+    SnapshotCoordinator& operator=(const SnapshotCoordinator& c) = delete;
+
+    ~SnapshotCoordinator();
+
+    SnapshotChannel& channel(size_t shard) { return *channels.at(shard); };
+    size_t shards() const { return channels.size(); };
+
+    /* Requests a snapshot at sequence; false until the previous one is collected */
+    bool request(uint64_t sequence);
+
+    /* Blocks until the requested snapshot is materialised */
+    ConsistentSnapshot wait();
+
+private:
+    friend class SnapshotChannel;
+
+    // the sequence is written before the epoch is released to the shards
+    std::atomic<uint32_t> epoch{0};
+    std::atomic<uint64_t> sequence{0};
+    std::vector<std::unique_ptr<SnapshotChannel>> channels;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t shards_done{0};
+    bool in_flight{false};
+    bool ready{false};
+    bool stopping{false};
+    ConsistentSnapshot result;
+    std::thread materialiser;
+
+    void shardDone();
+    void materialise();
+};
+
+#endif
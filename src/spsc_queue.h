@@ -0,0 +1,70 @@
+#include <atomic>
+#include <cstddef>
+
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+/*
+* Bounded lock-free queue for exactly one producer and one consumer thread.
+*
+* Capacity must be a power of two. Each side caches the other side's index so
+* the shared cache line is only read when the cached value runs out.
+*/
+template<typename T, size_t Capacity>
+class SPSCQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    bool push(const T& item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - cached_head == Capacity)
+        {
+            cached_head = _head.load(std::memory_order_acquire);
+            if (tail - cached_head == Capacity)
+            {
+                return false;
+            }
+        }
+
+        items[tail & (Capacity - 1)] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == cached_tail)
+        {
+            cached_tail = _tail.load(std::memory_order_acquire);
+            if (head == cached_tail)
+            {
+                return false;
+            }
+        }
+
+        item = items[head & (Capacity - 1)];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return Capacity; };
+
+private:
+    // producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<size_t> _tail{0};
+    size_t cached_head{0};
+    alignas(64) std::atomic<size_t> _head{0};
+    size_t cached_tail{0};
+    // value-initialised so a slot is never read before it was first written
+    alignas(64) T items[Capacity]{};
+};
+
+#endif
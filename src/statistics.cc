@@ -0,0 +1,77 @@
+#include <algorithm>
+
+#include "statistics.h"
+
+
+/* Folds a trade into a summary, opening it if it has no trades yet */
+static void accumulate(TradeSummary& summary, uint64_t price, uint64_t quantity)
+{
+    if (summary.trade_count == 0)
+    {
+        summary.open = summary.high = summary.low = price;
+    }
+
+    summary.high = std::max(summary.high, price);
+    summary.low = std::min(summary.low, price);
+    summary.last = price;
+    summary.volume += quantity;
+    summary.notional += price * quantity;
+    summary.trade_count++;
+}
+
+TradeStatistics::TradeStatistics(uint64_t window_ms, uint32_t buckets)
+    :_window_ms{window_ms},
+    bucket_ms{std::max<uint64_t>(window_ms / std::max<uint32_t>(buckets, 1), 1)},
+    buckets(std::max<uint32_t>(buckets, 1))
+{}
+
+void TradeStatistics::record(uint64_t price, uint64_t quantity, uint64_t timestamp)
+{
+    accumulate(_session, price, quantity);
+
+    // a bucket still holding an older period is recycled for this one
+    uint64_t id = timestamp / bucket_ms;
+    Bucket& bucket = buckets[id % buckets.size()];
+    if (bucket.id != id)
+    {
+        bucket.id = id;
+        bucket.summary = TradeSummary{};
+    }
+    accumulate(bucket.summary, price, quantity);
+}
+
+void TradeStatistics::resetSession()
+{
+    _session = TradeSummary{};
+}
+
+TradeSummary TradeStatistics::rolling(uint64_t now) const
+{
+    uint64_t current = now / bucket_ms;
+    uint64_t oldest = current >= buckets.size() - 1 ? current - (buckets.size() - 1) : 0;
+
+    // fold live buckets in time order so open and last come out right
+    TradeSummary result;
+    for (uint64_t id = oldest; id <= current; id++)
+    {
+        const Bucket& bucket = buckets[id % buckets.size()];
+        if (bucket.id != id || bucket.summary.trade_count == 0)
+            continue;
+
+        const TradeSummary& summary = bucket.summary;
+        if (result.trade_count == 0)
+        {
+            result.open = summary.open;
+            result.high = summary.high;
+            result.low = summary.low;
+        }
+        result.high = std::max(result.high, summary.high);
+        result.low = std::min(result.low, summary.low);
+        result.last = summary.last;
+        result.volume += summary.volume;
+        result.notional += summary.notional;
+        result.trade_count += summary.trade_count;
+    }
+
+    return result;
+}
@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <vector>
+
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+const uint64_t __STATS_WINDOW_MS__{60 * 1000};
+const uint32_t __STATS_BUCKETS__{60};
+
+/* Trade summary over a session or window. Prices are in level (tick) units. */
+struct TradeSummary {
+    uint64_t open{0};
+    uint64_t high{0};
+    uint64_t low{0};
+    uint64_t last{0};
+    uint64_t volume{0};
+    uint64_t notional{0};
+    uint64_t trade_count{0};
+
+    double vwap() const { return volume == 0 ? 0 : (double)notional / volume; };
+};
+
+/*
+* Session and rolling-window trade statistics updated once per fill.
+*
+* The rolling window is split into fixed time buckets held in a ring. Recording
+* a trade touches the session summary and one bucket, so updates are O(1); a
+* rolling summary folds the live buckets together, which is O(buckets).
+*/
+class TradeStatistics {
+public:
+    TradeStatistics(uint64_t window_ms=__STATS_WINDOW_MS__, uint32_t buckets=__STATS_BUCKETS__);
+
+    void record(uint64_t price, uint64_t quantity, uint64_t timestamp);
+
+    /* Clears the session summary; the rolling window is left intact */
+    void resetSession();
+
+    const TradeSummary& session() const { return _session; };
+
+    /* Summary of trades in the window ending at now (milliseconds) */
+    TradeSummary rolling(uint64_t now) const;
+
+    uint64_t window_ms() const { return _window_ms; };
+
+private:
+    struct Bucket {
+        uint64_t id{UINT64_MAX};
+        TradeSummary summary;
+    };
+
+    uint64_t _window_ms;
+    uint64_t bucket_ms;
+    TradeSummary _session;
+    std::vector<Bucket> buckets;
+};
+
+#endif
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+#include "trace.h"
+
+
+const char* __TRACE_STAGE_NAMES__[__TRACE_STAGES__]{"receive", "add_order", "match", "publish", "ack"};
+const uint32_t __TRACE_DUMP_VERSION__{1};
+
+struct TraceBuffer {
+    SPSCQueue<TraceRecord, __TRACE_BUFFER_SIZE__> records;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> retired{false};
+};
+
+static std::atomic<bool> trace_enabled{false};
+
+// every thread's buffer, kept until drained after the thread exits
+static std::mutex trace_mutex;
+static std::vector<std::shared_ptr<TraceBuffer>> trace_buffers;
+
+// hot per-thread state is trivially destructible so accessing it needs no guard
+struct TraceState {
+    TraceRecord current;
+    TraceBuffer* buffer;
+    bool active;
+};
+static thread_local TraceState trace_state{};
+
+struct TraceRegistration {
+    std::shared_ptr<TraceBuffer> buffer;
+
+    ~TraceRegistration()
+    {
+        if (buffer != nullptr)
+            buffer->retired.store(true, std::memory_order_release);
+    }
+};
+static thread_local TraceRegistration trace_registration;
+
+double traceCyclesPerNanosecond()
+{
+    static const double cycles_per_ns = [] {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t cycles = traceCycles();
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+        cycles = traceCycles() - cycles;
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        return elapsed.count() == 0 ? 1.0 : (double)cycles / elapsed.count();
+    }();
+    return cycles_per_ns;
+}
+
+void setTracing(bool enabled)
+{
+    trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool tracingEnabled()
+{
+    return trace_enabled.load(std::memory_order_relaxed);
+}
+
+void traceBegin(uint64_t received)
+{
+    if (!trace_enabled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    std::memset(&trace_state.current, 0, sizeof(TraceRecord));
+    trace_state.current.stamps[(size_t)TraceStage::Receive] = received;
+    trace_state.active = true;
+}
+
+void tracePoint(TraceStage stage)
+{
+    if (trace_state.active)
+    {
+        trace_state.current.stamps[(size_t)stage] = traceCycles();
+    }
+}
+
+void traceEnd()
+{
+    if (!trace_state.active)
+    {
+        return;
+    }
+    trace_state.active = false;
+
+    if (trace_state.buffer == nullptr)
+    {
+        // first record on this thread: register a buffer for the aggregator
+        std::lock_guard<std::mutex> lock{trace_mutex};
+        trace_registration.buffer = std::make_shared<TraceBuffer>();
+        trace_buffers.push_back(trace_registration.buffer);
+        trace_state.buffer = trace_registration.buffer.get();
+    }
+    if (!trace_state.buffer->records.push(trace_state.current))
+    {
+        trace_state.buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+
+static size_t bucketIndex(uint64_t cycles)
+{
+    if (cycles < 4)
+    {
+        return cycles;
+    }
+    int exponent = 63 - __builtin_clzll(cycles);
+    return (exponent - 1) * 4 + ((cycles >> (exponent - 2)) & 3);
+}
+
+static uint64_t bucketUpperBound(size_t index)
+{
+    if (index < 4)
+    {
+        return index;
+    }
+    int exponent = index / 4 + 1;
+    uint64_t lower = (4 + index % 4) << (exponent - 2);
+    return lower + (uint64_t{1} << (exponent - 2)) - 1;
+}
+
+void TraceHistogram::record(uint64_t cycles)
+{
+    count++;
+    total += cycles;
+    min = std::min(min, cycles);
+    max = std::max(max, cycles);
+    buckets[bucketIndex(cycles)]++;
+}
+
+uint64_t TraceHistogram::percentile(double quantile) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(quantile * count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < __TRACE_BUCKETS__; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), max);
+    }
+    return max;
+}
+
+
+TraceAggregator::TraceAggregator()
+    :format{TraceFormat::Text},
+    interval{__TRACE_INTERVAL__}
+{}
+
+TraceAggregator::TraceAggregator(const std::string& path, TraceFormat format, std::chrono::milliseconds interval)
+    :path{path},
+    format{format},
+    interval{interval}
+{
+    // calibrate before matching starts rather than on the first dump
+    traceCyclesPerNanosecond();
+    running = true;
+    exporter = std::thread{&TraceAggregator::exportLoop, this};
+}
+
+TraceAggregator::~TraceAggregator()
+{
+    if (exporter.joinable())
+    {
+        running = false;
+        exporter.join();
+    }
+}
+
+size_t TraceAggregator::drain()
+{
+    std::lock_guard<std::mutex> buffers_lock{trace_mutex};
+    std::lock_guard<std::mutex> lock{mutex};
+
+    size_t drained = 0;
+    TraceRecord record;
+    for (auto it = trace_buffers.begin(); it != trace_buffers.end();)
+    {
+        TraceBuffer& buffer = **it;
+        bool retired = buffer.retired.load(std::memory_order_acquire);
+        while (buffer.records.pop(record))
+        {
+            drained++;
+            uint64_t first = 0;
+            uint64_t previous = 0;
+            for (size_t stage = 0; stage < __TRACE_STAGES__; stage++)
+            {
+                uint64_t stamp = record.stamps[stage];
+                if (stamp == 0)
+                    continue;
+                if (previous != 0 && stamp >= previous)
+                    stages[stage].record(stamp - previous);
+                if (first == 0)
+                    first = stamp;
+                previous = stamp;
+            }
+            if (previous > first)
+                _total.record(previous - first);
+        }
+        _dropped += buffer.dropped.exchange(0, std::memory_order_relaxed);
+
+        // the thread is gone and its buffer is empty
+        if (retired)
+            it = trace_buffers.erase(it);
+        else
+            ++it;
+    }
+
+    _records += drained;
+    return drained;
+}
+
+TraceHistogram TraceAggregator::histogram(TraceStage stage) const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return stages[(size_t)stage];
+}
+
+TraceHistogram TraceAggregator::total() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return _total;
+}
+
+uint64_t TraceAggregator::records() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return _records;
+}
+
+uint64_t TraceAggregator::dropped() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return _dropped;
+}
+
+template<typename T>
+static void writeValue(std::ostream& os, T value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void writeHistogram(std::ostream& os, const TraceHistogram& histogram)
+{
+    writeValue<uint64_t>(os, histogram.count);
+    writeValue<uint64_t>(os, histogram.total);
+    writeValue<uint64_t>(os, histogram.count == 0 ? 0 : histogram.min);
+    writeValue<uint64_t>(os, histogram.max);
+
+    uint16_t used = std::count_if(std::begin(histogram.buckets), std::end(histogram.buckets), [](uint64_t b) { return b != 0; });
+    writeValue<uint16_t>(os, used);
+    for (size_t i = 0; i < __TRACE_BUCKETS__; i++)
+    {
+        if (histogram.buckets[i] == 0)
+            continue;
+        writeValue<uint16_t>(os, i);
+        writeValue<uint64_t>(os, histogram.buckets[i]);
+    }
+}
+
+void TraceAggregator::dump(std::ostream& os, TraceFormat format) const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    if (format == TraceFormat::Binary)
+    {
+        os.write("OBTR", 4);
+        writeValue<uint32_t>(os, __TRACE_DUMP_VERSION__);
+        writeValue<uint64_t>(os, _records);
+        writeValue<uint64_t>(os, _dropped);
+        for (size_t stage = 1; stage < __TRACE_STAGES__; stage++)
+            writeHistogram(os, stages[stage]);
+        writeHistogram(os, _total);
+        return;
+    }
+
+    // text dumps are in nanoseconds
+    double cycles_per_ns = traceCyclesPerNanosecond();
+    os << "trace records=" << _records << " dropped=" << _dropped << " cycles/ns=" << cycles_per_ns << "\n";
+    os << std::left << std::setw(10) << "stage" << std::right
+        << std::setw(12) << "count" << std::setw(10) << "mean" << std::setw(10) << "p50"
+        << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << "\n";
+    auto line = [&](const char* name, const TraceHistogram& histogram) {
+        os << std::left << std::setw(10) << name << std::right
+            << std::setw(12) << histogram.count
+            << std::setw(10) << (uint64_t)(histogram.mean() / cycles_per_ns)
+            << std::setw(10) << (uint64_t)(histogram.percentile(0.5) / cycles_per_ns)
+            << std::setw(10) << (uint64_t)(histogram.percentile(0.99) / cycles_per_ns)
+            << std::setw(10) << (uint64_t)(histogram.percentile(0.999) / cycles_per_ns)
+            << std::setw(10) << (uint64_t)(histogram.max / cycles_per_ns) << "\n";
+    };
+    for (size_t stage = 1; stage < __TRACE_STAGES__; stage++)
+        line(__TRACE_STAGE_NAMES__[stage], stages[stage]);
+    line("total", _total);
+}
+
+void TraceAggregator::exportLoop()
+{
+    std::ofstream file{path, std::ios::binary | std::ios::app};
+    auto next = std::chrono::steady_clock::now() + interval;
+    while (running)
+    {
+        // drain well before a busy thread's buffer fills, dump every interval
+        std::this_thread::sleep_for(std::min(interval, __TRACE_DRAIN_INTERVAL__));
+        drain();
+        if (std::chrono::steady_clock::now() < next)
+            continue;
+
+        next += interval;
+        dump(file, format);
+        file.flush();
+    }
+
+    drain();
+    dump(file, format);
+}
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "spsc_queue.h"
+
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// records each thread can buffer before the aggregator drains them
+const size_t __TRACE_BUFFER_SIZE__{16384};
+// four sub-buckets per power of two: 2^2 exact values then 62 octaves
+const size_t __TRACE_BUCKETS__{252};
+const std::chrono::milliseconds __TRACE_INTERVAL__{1000};
+const std::chrono::milliseconds __TRACE_DRAIN_INTERVAL__{10};
+
+/*
+* Points a message passes through in order. Receive is stamped by the thread
+* that read the message off the wire, the rest by the matching thread.
+*/
+enum class TraceStage : uint8_t {
+    Receive = 0,
+    // entry to OrderBook::addOrder
+    AddOrder = 1,
+    // match loop done, before the remainder rests
+    Match = 2,
+    // book and market data updated, addOrder returns
+    Publish = 3,
+    // acknowledgement queued back to the sender
+    Ack = 4,
+};
+
+const size_t __TRACE_STAGES__{5};
+
+/* Cycle-counter stamps of one message, 0 for stages it did not pass */
+struct TraceRecord {
+    uint64_t stamps[__TRACE_STAGES__];
+};
+
+/* Cycle counter: rdtsc on x86, a monotonic nanosecond clock elsewhere */
+inline uint64_t traceCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/* Cycles per nanosecond, measured once against the steady clock */
+double traceCyclesPerNanosecond();
+
+/*
+* Runtime switch for every trace point. While off, traceBegin() costs one
+* relaxed load and the other trace points a thread-local branch.
+*
+* Each thread records one message at a time: traceBegin() opens a record,
+* optionally with a receive stamp taken on another thread. tracePoint() stamps
+* a stage and traceEnd() queues the record on the thread's own lock-free
+* buffer. Records that do not fit are counted as dropped.
+*/
+void setTracing(bool enabled);
+bool tracingEnabled();
+void traceBegin(uint64_t received=0);
+void tracePoint(TraceStage stage);
+void traceEnd();
+
+/* Log-linear histogram of cycle counts, ~19% wide buckets */
+struct TraceHistogram {
+    uint64_t count{0};
+    uint64_t total{0};
+    uint64_t min{UINT64_MAX};
+    uint64_t max{0};
+    uint64_t buckets[__TRACE_BUCKETS__]{};
+
+    void record(uint64_t cycles);
+
+    /* Upper bound of the bucket holding the given quantile, 0 when empty */
+    uint64_t percentile(double quantile) const;
+    double mean() const { return count == 0 ? 0 : (double)total / count; };
+};
+
+enum class TraceFormat {
+    Text,
+    Binary,
+};
+
+/*
+* Aggregates every thread's trace records into per-stage histograms of the
+* cycles since the previous stamped stage, plus first-to-last stamp totals.
+*
+* With a path, a background thread drains the buffers every 10ms and appends
+* a dump to the file every interval. Without one, the owner calls drain(). Only one
+* aggregator drains at a time.
+*
+* The binary dump is "OBTR", a version, the record and drop counts, then per
+* histogram its count, total, min, max, the number of non-empty buckets and
+* (uint16 index, uint64 count) pairs, all little-endian.
+*/
+class TraceAggregator {
+public:
+    TraceAggregator();
+    TraceAggregator(const std::string& path, TraceFormat format=TraceFormat::Text, std::chrono::milliseconds interval=__TRACE_INTERVAL__);
+
+    TraceAggregator(const TraceAggregator& a) = delete;
+    TraceAggregator& operator=(const TraceAggregator& a) = delete;
+
+    ~TraceAggregator();
+
+    /* Moves buffered records into the histograms and returns how many */
+    size_t drain();
+
+    /* Cycles from the previous stamped stage to stage; empty for Receive */
+    TraceHistogram histogram(TraceStage stage) const;
+    TraceHistogram total() const;
+
+    uint64_t records() const;
+    uint64_t dropped() const;
+
+    void dump(std::ostream& os, TraceFormat format=TraceFormat::Text) const;
+
+private:
+    mutable std::mutex mutex;
+    TraceHistogram stages[__TRACE_STAGES__];
+    TraceHistogram _total;
+    uint64_t _records{0};
+    uint64_t _dropped{0};
+
+    std::string path;
+    TraceFormat format;
+    std::chrono::milliseconds interval;
+    std::atomic<bool> running{false};
+    std::thread exporter;
+
+    void exportLoop();
+};
+
+#endif
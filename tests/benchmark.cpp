@@ -1,20 +1,29 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <iomanip>
 #include <chrono>
 #include <vector>
 #include <type_traits>
 #include <random>
 #include <assert.h>
 #include <memory>
+#include <map>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-#include "../src/orderbook.cc"
+#include "orderbook.h"
+#include "level_book.h"
+#include "ladder.h"
 
 
 #define __NUM_ORDERS__ 10000
 #define __MIN_RANGE__ 5
 #define __MAX_RANGE__ 10
-#define durationMs(a) std::chrono::duration_cast<std::chrono::milliseconds>(a);
+#define durationUs(a) std::chrono::duration_cast<std::chrono::microseconds>(a);
 
 
 /*
@@ -106,34 +115,184 @@ Order** getOrdersFromFile(OrderBook& orderbook, int num_orders, int min_range, i
     return orders;
 }
 
-int run_test(OrderBook& orderbook, Order** orders, int num_orders)
+/*
+ * Opens a counter for data-TLB load misses on this thread. Returns -1 when
+ * perf events are unavailable (e.g. containers or perf_event_paranoid).
+ */
+int openTlbCounter()
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_DTLB
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int64_t run_test(OrderBook& orderbook, Order** orders, int num_orders, int64_t& tlb_misses)
 {
+    int counter = openTlbCounter();
+    if (counter != -1)
+    {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
     auto start = std::chrono::steady_clock::now();
 
-    for (int i; i < num_orders; i++)
+    for (int i = 0; i < num_orders; i++)
     {
-        Order order = **orders;
+        Order order = *orders[i];
         orderbook.addOrder(order);
-        orders++;
-        if (*orders == nullptr)
-        {
-            return -1;
-        }
     }
 
     auto end = std::chrono::steady_clock::now();
-    auto dur = durationMs(end - start);
+    auto dur = durationUs(end - start);
+
+    tlb_misses = -1;
+    if (counter != -1)
+    {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        read(counter, &tlb_misses, sizeof(tlb_misses));
+        close(counter);
+    }
 
     return dur.count();
 }
 
+/* Aggregate level state after each order, as a market-by-price feed sends it */
+struct LevelUpdate {
+    bool is_bid;
+    uint64_t price;
+    uint64_t volume;
+    uint32_t order_count;
+};
+
+std::vector<LevelUpdate> buildLevelUpdates(Order** orders, int num_orders)
+{
+    std::map<std::pair<bool, uint64_t>, std::pair<uint64_t, uint32_t>> levels;
+    std::vector<LevelUpdate> updates;
+    updates.reserve(num_orders);
+    for (int i = 0; i < num_orders; i++)
+    {
+        auto& [volume, count] = levels[{orders[i]->is_bid(), orders[i]->price()}];
+        volume += orders[i]->open_quantity();
+        count++;
+        updates.push_back(LevelUpdate{orders[i]->is_bid(), orders[i]->price(), volume, count});
+    }
+    return updates;
+}
+
+template <typename Book>
+int64_t run_level_test(Book& book, const std::vector<LevelUpdate>& updates, int64_t& tlb_misses)
+{
+    int counter = openTlbCounter();
+    if (counter != -1)
+    {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    for (const LevelUpdate& update : updates)
+    {
+        book.applyLevel(update.is_bid, update.price, update.volume, update.order_count);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    auto dur = durationUs(end - start);
+
+    tlb_misses = -1;
+    if (counter != -1)
+    {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        read(counter, &tlb_misses, sizeof(tlb_misses));
+        close(counter);
+    }
+
+    return dur.count();
+}
+
+/*
+ * Layout of a resting order before the pool: a virtual node allocated with
+ * make_shared and queued through shared_ptr links, with a level holding the
+ * head and tail links.
+ */
+struct LegacyOrder {
+    std::shared_ptr<LegacyOrder> next_order;
+    std::shared_ptr<LegacyOrder> prev_order;
+    uint64_t id;
+    uint64_t created_at;
+    bool is_bid;
+    uint64_t quantity;
+    uint64_t filled_quantity;
+    uint64_t filled_cost;
+    uint64_t price;
+
+    virtual ~LegacyOrder() = default;
+};
+
+struct LegacyLevelLinks {
+    std::shared_ptr<LegacyOrder> head_order;
+    std::shared_ptr<LegacyOrder> tail_order;
+};
+
+/* Counts the bytes make_shared asks for, control block included */
+template <typename T>
+struct CountingAllocator {
+    typedef T value_type;
+    size_t* bytes;
+
+    CountingAllocator(size_t* bytes) : bytes{bytes} {};
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& a) : bytes{a.bytes} {};
+
+    T* allocate(size_t n) { *bytes += n * sizeof(T); return std::allocator<T>{}.allocate(n); };
+    void deallocate(T* p, size_t n) { std::allocator<T>{}.deallocate(p, n); };
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& a, const CountingAllocator<U>& b) { return a.bytes == b.bytes; }
+
+/* Reports the per-order node and level-link bytes before and after the pool */
+void reportOrderFootprint()
+{
+    size_t legacy_node = 0;
+    std::allocate_shared<LegacyOrder>(CountingAllocator<LegacyOrder>{&legacy_node});
+    size_t legacy = legacy_node + sizeof(LegacyLevelLinks);
+    size_t pooled = sizeof(RestingOrder) + sizeof(RestingOrderInfo) + 2 * sizeof(uint32_t);
+
+    std::cout << "Per-order footprint: before " << legacy << "B ("
+        << legacy_node << "B shared node + " << sizeof(LegacyLevelLinks) << "B level links)"
+        << ", now " << pooled << "B (" << sizeof(RestingOrder) << "B hot + "
+        << sizeof(RestingOrderInfo) << "B cold + " << 2 * sizeof(uint32_t) << "B level links)"
+        << ", " << std::fixed << std::setprecision(2) << (double)legacy / pooled << "x smaller \n";
+    std::cout.unsetf(std::ios_base::floatfield);
+}
+
+/* Reports time in ms and throughput in messages per second */
+void report(const char* name, int64_t dur, size_t messages, int64_t tlb_misses)
+{
+    std::cout << name << " time taken: " << dur / 1000 << "ms"
+        << ", throughput: " << (uint64_t)(messages * 1e6 / std::max<int64_t>(dur, 1)) << " msg/s";
+    if (tlb_misses >= 0)
+        std::cout << ", dTLB load misses: " << tlb_misses;
+    else
+        std::cout << ", dTLB load misses: unavailable";
+    std::cout << " \n";
+}
+
 int main(int argc, const char* argv[])
 {
     int num_orders = __NUM_ORDERS__;
     int min_range = __MIN_RANGE__;
     int max_range = __MAX_RANGE__;
     if (argc > 1) {
-        for (int i = 1; i <= argc; i++) {
+        for (int i = 1; i < argc; i++) {
             if (i == 1)
                 num_orders = std::atoi(argv[1]);
             else if (i == 2)
@@ -148,11 +307,81 @@ int main(int argc, const char* argv[])
 
     OrderBook orderbook{2};
     Order** orders = getOrdersFromFile(orderbook, num_orders, min_range, max_range);
-    auto dur = run_test(orderbook, orders, num_orders);
-    std::cout << "Time take: " << dur << "ms \n";
+
+    int64_t heap_misses;
+    auto heap_dur = run_test(orderbook, orders, num_orders, heap_misses);
+    report("Heap", heap_dur, num_orders, heap_misses);
+
+    // same workload with orders and limits in a pre-faulted huge-page arena
+    Arena arena;
+    OrderBook arena_orderbook{2, MatchingPolicy::PriceTime, &arena};
+    int64_t arena_misses;
+    auto arena_dur = run_test(arena_orderbook, orders, num_orders, arena_misses);
+    report("Arena", arena_dur, num_orders, arena_misses);
+
+    const char* backing[] = {"hugetlb", "transparent huge pages", "regular pages"};
+    std::cout << "Arena backing: " << backing[(int)arena.backing()]
+        << ", node: " << arena.node()
+        << ", used: " << arena.used() / 1024 << "KiB \n";
+
+    // resting-only workload: per-order book against aggregated levels
+    Arena order_arena;
+    OrderBook resting_orderbook{2, MatchingPolicy::PriceTime, &order_arena};
+    resting_orderbook.setAuctionMode(true);
+    int64_t resting_misses;
+    auto resting_dur = run_test(resting_orderbook, orders, num_orders, resting_misses);
+    report("Per-order book", resting_dur, num_orders, resting_misses);
+
+    std::vector<LevelUpdate> updates = buildLevelUpdates(orders, num_orders);
+    Arena level_arena;
+    MBPBook level_book{&level_arena};
+    int64_t level_misses;
+    auto level_dur = run_level_test(level_book, updates, level_misses);
+    report("Price-level book", level_dur, updates.size(), level_misses);
+
+    // same updates on a price-indexed ladder, then depth scans with each kernel
+    uint64_t low = UINT64_MAX, high = 0;
+    for (const LevelUpdate& update : updates)
+    {
+        low = std::min(low, update.price);
+        high = std::max(high, update.price);
+    }
+    LadderBook ladder{low, high};
+    int64_t ladder_misses;
+    auto ladder_dur = run_level_test(ladder, updates, ladder_misses);
+    report("Ladder book", ladder_dur, updates.size(), ladder_misses);
+
+    LadderKernel detected = ladderKernel();
+    const char* kernels[] = {"AVX2", "SSE", "scalar"};
+    for (LadderKernel kernel : {LadderKernel::AVX2, LadderKernel::SSE, LadderKernel::Scalar})
+    {
+        if (!ladderKernelSupported(kernel))
+            continue;
+        setLadderKernel(kernel);
+        uint64_t checksum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_orders; i++)
+        {
+            checksum += ladder.depthVolume(i % 2, 10);
+        }
+        auto dur = durationUs(std::chrono::steady_clock::now() - start);
+        std::string name = std::string("Ladder depth (") + kernels[(int)kernel] + ")";
+        report(name.c_str(), dur.count(), num_orders, -1);
+        if (checksum == 0)
+            std::cout << "Ladder is empty \n";
+    }
+    setLadderKernel(detected);
+
+    // per resting order: pool slots plus the amortised cost of its level
+    std::cout << "Resting order layout: " << sizeof(RestingOrder) << "B hot + "
+        << sizeof(RestingOrderInfo) << "B cold, "
+        << order_arena.used() / std::max<uint>(resting_orderbook.size(), 1) << "B per resting order \n";
+    reportOrderFootprint();
+    std::cout << "Per-order book used: " << order_arena.used() / 1024 << "KiB"
+        << ", price-level book used: " << level_arena.used() / 1024 << "KiB \n";
 
     // clean-up :)
-    for (uint i; i <= num_orders; i++)
+    for (int i = 0; i <= num_orders; i++)
     {
         delete orders[i];
     }
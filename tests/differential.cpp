@@ -0,0 +1,33 @@
+#include <iostream>
+
+#include "orderbook.h"
+#include "differential.h"
+
+
+#define __NUM_MESSAGES__ 2000000
+#define __SEED__ 1337
+
+/*
+ * Usage: differential [num_messages] [seed]
+ *
+ * Checks OrderBook against the reference book fill by fill over a random
+ * message stream and reports messages/sec for both. Exits non-zero on the
+ * first divergence.
+ */
+int main(int argc, const char* argv[])
+{
+    size_t num_messages = argc > 1 ? std::atoll(argv[1]) : __NUM_MESSAGES__;
+    uint64_t seed = argc > 2 ? std::atoll(argv[2]) : __SEED__;
+
+    DifferentialResult result = runDifferential(num_messages, seed, "/orderbook_differential");
+    if (!result.matched)
+    {
+        std::cerr << "Mismatch at " << result.mismatch << " (seed " << seed << ") \n";
+        return 1;
+    }
+
+    std::cout << "Messages: " << result.messages << ", fills compared: " << result.fills << " \n";
+    std::cout << "OrderBook: " << (uint64_t)result.book_rate << " msg/s \n";
+    std::cout << "Reference: " << (uint64_t)result.reference_rate << " msg/s \n";
+    return 0;
+}
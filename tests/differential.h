@@ -0,0 +1,336 @@
+#include <chrono>
+#include <functional>
+#include <list>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/orderbook.h"
+#include "../src/market_data.h"
+
+
+#ifndef DIFFERENTIAL_H
+#define DIFFERENTIAL_H
+
+struct ReferenceFill {
+    uint64_t price;
+    uint64_t quantity;
+    uint64_t maker_id;
+
+    bool operator==(const ReferenceFill& f) const { return price == f.price && quantity == f.quantity && maker_id == f.maker_id; };
+};
+
+/*
+* Deliberately naive price-time book used as the oracle for OrderBook.
+*
+* Levels are ordered maps of plain lists and cancels search the level for the
+* order, so there is as little to get wrong as possible. Fills are at the
+* resting order's price.
+*/
+class ReferenceBook {
+public:
+    std::vector<ReferenceFill> fills;
+
+    /* Matches then rests the remainder; returns the quantity filled */
+    uint64_t add(uint64_t id, bool is_bid, uint64_t quantity, uint64_t price)
+    {
+        fills.clear();
+        uint64_t filled = is_bid ? sweep(asks, quantity, [&](uint64_t p) { return p <= price; })
+            : sweep(bids, quantity, [&](uint64_t p) { return p >= price; });
+        if (filled < quantity)
+        {
+            if (is_bid)
+                bids[price].push_back(RestingOrder{id, quantity - filled});
+            else
+                asks[price].push_back(RestingOrder{id, quantity - filled});
+            sides[id] = {is_bid, price};
+        }
+        return filled;
+    }
+
+    uint64_t market(bool is_bid, uint64_t quantity)
+    {
+        fills.clear();
+        return is_bid ? sweep(asks, quantity, [](uint64_t) { return true; })
+            : sweep(bids, quantity, [](uint64_t) { return true; });
+    }
+
+    /* Returns the open quantity cancelled, 0 if the order is not resting */
+    uint64_t cancel(uint64_t id)
+    {
+        fills.clear();
+        auto it = sides.find(id);
+        if (it == sides.end())
+        {
+            return 0;
+        }
+        auto [is_bid, price] = it->second;
+        sides.erase(it);
+        return is_bid ? removeFrom(bids, price, id) : removeFrom(asks, price, id);
+    }
+
+    /* (price, volume) of every level from the inside */
+    std::vector<std::pair<uint64_t, uint64_t>> levels(bool is_bid) const
+    {
+        return is_bid ? collect(bids) : collect(asks);
+    }
+
+    size_t size() const { return sides.size(); };
+
+private:
+    struct RestingOrder {
+        uint64_t id;
+        uint64_t quantity;
+    };
+
+    std::map<uint64_t, std::list<RestingOrder>, std::greater<uint64_t>> bids;
+    std::map<uint64_t, std::list<RestingOrder>> asks;
+    std::unordered_map<uint64_t, std::pair<bool, uint64_t>> sides;
+
+    template<typename Levels>
+    uint64_t sweep(Levels& levels, uint64_t quantity, std::function<bool(uint64_t)> crosses)
+    {
+        uint64_t filled = 0;
+        while (filled < quantity && !levels.empty() && crosses(levels.begin()->first))
+        {
+            auto level = levels.begin();
+            RestingOrder& maker = level->second.front();
+            uint64_t fill = std::min(quantity - filled, maker.quantity);
+            fills.push_back(ReferenceFill{level->first, fill, maker.id});
+            filled += fill;
+            maker.quantity -= fill;
+            if (maker.quantity == 0)
+            {
+                sides.erase(maker.id);
+                level->second.pop_front();
+                if (level->second.empty())
+                    levels.erase(level);
+            }
+        }
+        return filled;
+    }
+
+    template<typename Levels>
+    static uint64_t removeFrom(Levels& levels, uint64_t price, uint64_t id)
+    {
+        auto level = levels.find(price);
+        for (auto order = level->second.begin(); order != level->second.end(); order++)
+        {
+            if (order->id == id)
+            {
+                uint64_t quantity = order->quantity;
+                level->second.erase(order);
+                if (level->second.empty())
+                    levels.erase(level);
+                return quantity;
+            }
+        }
+        return 0;
+    }
+
+    template<typename Levels>
+    static std::vector<std::pair<uint64_t, uint64_t>> collect(const Levels& levels)
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> result;
+        for (auto& [price, orders] : levels)
+        {
+            uint64_t volume = 0;
+            for (const RestingOrder& order : orders)
+                volume += order.quantity;
+            result.push_back({price, volume});
+        }
+        return result;
+    }
+};
+
+enum class DifferentialMessageType {
+    Add,
+    Cancel,
+    Market,
+};
+
+struct DifferentialMessage {
+    DifferentialMessageType type;
+    bool is_bid;
+    uint32_t quantity;
+    uint64_t price;
+    // id of the order to cancel
+    uint64_t order_id;
+};
+
+struct DifferentialResult {
+    uint64_t messages;
+    uint64_t fills;
+    bool matched;
+    std::string mismatch;
+    double book_rate;
+    double reference_rate;
+};
+
+/* Applies one message to the book, returning the quantity filled or cancelled */
+inline uint64_t applyDifferential(OrderBook& book, const DifferentialMessage& message)
+{
+    switch (message.type)
+    {
+        case DifferentialMessageType::Add:
+        {
+            Order order = book.createLevelOrder(message.is_bid, message.quantity, 0, message.price);
+            book.addOrder(order);
+            return order.filled_quantity();
+        }
+        case DifferentialMessageType::Cancel:
+            return book.sendCancelOrder(message.order_id);
+        case DifferentialMessageType::Market:
+            return book.sendMarketOrder(message.is_bid, message.quantity);
+    }
+    return 0;
+}
+
+inline uint64_t applyDifferential(ReferenceBook& book, const DifferentialMessage& message, uint64_t& next_id)
+{
+    switch (message.type)
+    {
+        case DifferentialMessageType::Add:
+            return book.add(next_id++, message.is_bid, message.quantity, message.price);
+        case DifferentialMessageType::Cancel:
+            return book.cancel(message.order_id);
+        case DifferentialMessageType::Market:
+            next_id++;
+            return book.market(message.is_bid, message.quantity);
+    }
+    return 0;
+}
+
+/*
+* Random adds (often crossing), cancels and market orders around a fixed mid.
+* Each order is cancelled at most once, some after they have filled. Adds and
+* cancels are equally likely, which keeps the book at a steady size. Ids follow
+* the book's own assignment: every add and market order takes the next id from 1.
+*/
+inline std::vector<DifferentialMessage> generateDifferentialMessages(size_t messages, uint64_t seed)
+{
+    std::mt19937_64 gen{seed};
+    std::uniform_int_distribution<int> action(0, 99);
+    std::uniform_int_distribution<uint64_t> offset(0, 40);
+    std::uniform_int_distribution<uint32_t> quantity(1, 100);
+
+    std::vector<DifferentialMessage> result;
+    result.reserve(messages);
+    std::vector<uint64_t> live;
+    uint64_t next_id = 1;
+    for (size_t i = 0; i < messages; i++)
+    {
+        int roll = action(gen);
+        if (roll < 46 || live.empty())
+        {
+            // limit prices overlap the mid, so a fraction of adds cross
+            bool is_bid = roll % 2 == 0;
+            uint64_t price = is_bid ? 970 + offset(gen) : 1030 - offset(gen);
+            result.push_back(DifferentialMessage{DifferentialMessageType::Add, is_bid, quantity(gen), price, 0});
+            live.push_back(next_id++);
+        }
+        else if (roll < 92) {
+            size_t index = gen() % live.size();
+            result.push_back(DifferentialMessage{DifferentialMessageType::Cancel, false, 0, 0, live[index]});
+            live[index] = live.back();
+            live.pop_back();
+        }
+        else {
+            result.push_back(DifferentialMessage{DifferentialMessageType::Market, roll % 2 == 0, quantity(gen), 0, 0});
+            next_id++;
+        }
+    }
+    return result;
+}
+
+/*
+* Drives OrderBook and ReferenceBook with the same messages. The checked pass
+* compares every message's result and fills (read back from the book's market
+* data ring) and then the final levels of both sides; it stops at the first
+* mismatch. The timed passes run each book alone without publishing.
+*/
+inline DifferentialResult runDifferential(size_t messages, uint64_t seed, const std::string& ring_name)
+{
+    std::vector<DifferentialMessage> stream = generateDifferentialMessages(messages, seed);
+    DifferentialResult result{stream.size(), 0, true, "", 0, 0};
+
+    MarketDataPublisher publisher{ring_name, 1 << 16};
+    MarketDataReader reader{ring_name};
+    OrderBook book{0};
+    book.setPublisher(&publisher);
+    ReferenceBook reference;
+    uint64_t next_id = 1;
+
+    auto fail = [&](size_t index, const std::string& what) {
+        std::ostringstream message;
+        message << "message " << index << ": " << what;
+        result.matched = false;
+        result.mismatch = message.str();
+        return result;
+    };
+
+    for (size_t i = 0; i < stream.size(); i++)
+    {
+        uint64_t expected = applyDifferential(reference, stream[i], next_id);
+        uint64_t actual = applyDifferential(book, stream[i]);
+        if (expected != actual)
+            return fail(i, "quantity " + std::to_string(actual) + " expected " + std::to_string(expected));
+
+        size_t fill = 0;
+        MarketDataEvent event;
+        MarketDataReadStatus status;
+        while ((status = reader.read(event)) == MarketDataReadStatus::Ok)
+        {
+            if (event.type != MarketDataEventType::Trade)
+                continue;
+            if (fill == reference.fills.size())
+                return fail(i, "unexpected fill of maker " + std::to_string(event.maker_id));
+            if (!(ReferenceFill{event.price, event.quantity, event.maker_id} == reference.fills[fill]))
+                return fail(i, "fill " + std::to_string(fill) + " differs");
+            fill++;
+        }
+        if (status == MarketDataReadStatus::Overrun)
+            return fail(i, "market data ring overrun");
+        if (fill != reference.fills.size())
+            return fail(i, "missing fills");
+        result.fills += fill;
+    }
+
+    for (bool is_bid : {true, false})
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> expected = reference.levels(is_bid);
+        const std::vector<DepthLevel>& actual = book.depth(is_bid, SIZE_MAX);
+        if (expected.size() != actual.size())
+            return fail(stream.size(), "final level count differs");
+        for (size_t level = 0; level < expected.size(); level++)
+        {
+            if (expected[level].first != actual[level].price || expected[level].second != actual[level].volume)
+                return fail(stream.size(), "final level " + std::to_string(level) + " differs");
+        }
+    }
+    if (book.size() != reference.size())
+        return fail(stream.size(), "final order count differs");
+
+    // timed passes over fresh books
+    OrderBook timed_book{0};
+    auto start = std::chrono::steady_clock::now();
+    for (const DifferentialMessage& message : stream)
+        applyDifferential(timed_book, message);
+    auto end = std::chrono::steady_clock::now();
+    result.book_rate = stream.size() / std::max(std::chrono::duration<double>(end - start).count(), 1e-9);
+
+    ReferenceBook timed_reference;
+    next_id = 1;
+    start = std::chrono::steady_clock::now();
+    for (const DifferentialMessage& message : stream)
+        applyDifferential(timed_reference, message, next_id);
+    end = std::chrono::steady_clock::now();
+    result.reference_rate = stream.size() / std::max(std::chrono::duration<double>(end - start).count(), 1e-9);
+
+    return result;
+}
+
+#endif
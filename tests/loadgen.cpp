@@ -0,0 +1,157 @@
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../src/protocol.h"
+
+
+#define __NUM_ORDERS__ 100000
+#define __WINDOW__ 256
+#define __MIN_PRICE__ 500
+#define __MAX_PRICE__ 1000
+
+
+uint64_t nowNs()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+/*
+ * Build every order up front so the send loop only stamps and writes.
+ */
+std::vector<OrderMessage> generateOrders(int num_orders)
+{
+    static std::mt19937 gen{1337};
+    std::uniform_int_distribution<uint64_t> price(__MIN_PRICE__, __MAX_PRICE__);
+    std::uniform_int_distribution<uint32_t> quantity(1, 10);
+
+    std::vector<OrderMessage> orders(num_orders);
+    for (int i = 0; i < num_orders; i++)
+    {
+        orders[i] = OrderMessage{
+            MessageType::NewOrder,
+            (i % 2) == 0,
+            0,
+            quantity(gen) * 100,
+            (uint64_t)i,
+            price(gen),
+            0
+        };
+    }
+    return orders;
+}
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double p)
+{
+    size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+    return sorted[index];
+}
+
+/*
+ * Usage: loadgen [port] [num_orders] [window]
+ *
+ * Pipelines up to `window` orders over one connection to a running gateway and
+ * reports round-trip latency percentiles from the echoed send timestamps.
+ */
+int main(int argc, const char* argv[])
+{
+    uint16_t port = argc > 1 ? std::atoi(argv[1]) : 9000;
+    int num_orders = argc > 2 ? std::atoi(argv[2]) : __NUM_ORDERS__;
+    int window = argc > 3 ? std::atoi(argv[3]) : __WINDOW__;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == -1)
+    {
+        std::cerr << "Unable to connect to gateway on port " << port << "\n";
+        return 1;
+    }
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    std::vector<OrderMessage> orders = generateOrders(num_orders);
+    std::vector<uint64_t> latencies;
+    latencies.reserve(num_orders);
+    std::vector<AckMessage> acks(window);
+    size_t partial = 0;
+
+    int sent = 0;
+    int received = 0;
+    int rejected = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (received < num_orders)
+    {
+        // top up the window with a single send
+        int batch = std::min(window - (sent - received), num_orders - sent);
+        if (batch > 0)
+        {
+            uint64_t stamp = nowNs();
+            for (int i = sent; i < sent + batch; i++)
+                orders[i].sent_at = stamp;
+
+            const char* data = reinterpret_cast<const char*>(&orders[sent]);
+            size_t remaining = batch * sizeof(OrderMessage);
+            while (remaining > 0)
+            {
+                ssize_t n = send(fd, data, remaining, 0);
+                if (n <= 0)
+                {
+                    std::cerr << "Gateway closed the connection\n";
+                    return 1;
+                }
+                data += n;
+                remaining -= n;
+            }
+            sent += batch;
+        }
+
+        char* buffer = reinterpret_cast<char*>(acks.data());
+        ssize_t n = recv(fd, buffer + partial, window * sizeof(AckMessage) - partial, 0);
+        if (n <= 0)
+        {
+            std::cerr << "Gateway closed the connection\n";
+            return 1;
+        }
+
+        uint64_t now = nowNs();
+        size_t length = partial + n;
+        size_t complete = length / sizeof(AckMessage);
+        for (size_t i = 0; i < complete; i++)
+        {
+            latencies.push_back(now - acks[i].sent_at);
+            if (acks[i].type == MessageType::Reject)
+                rejected++;
+        }
+        received += complete;
+
+        partial = length % sizeof(AckMessage);
+        std::memmove(buffer, buffer + complete * sizeof(AckMessage), partial);
+    }
+    auto end = std::chrono::steady_clock::now();
+    close(fd);
+
+    std::sort(latencies.begin(), latencies.end());
+    auto dur = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    std::cout << "Orders: " << num_orders << " (rejected " << rejected << ") \n";
+    std::cout << "Throughput: " << (uint64_t)(num_orders * 1e6 / std::max<int64_t>(dur, 1)) << " msg/s \n";
+    std::cout << "RTT us p50: " << percentile(latencies, 0.50) / 1000.0
+        << " p90: " << percentile(latencies, 0.90) / 1000.0
+        << " p99: " << percentile(latencies, 0.99) / 1000.0
+        << " p99.9: " << percentile(latencies, 0.999) / 1000.0
+        << " max: " << latencies.back() / 1000.0 << "\n";
+
+    return 0;
+}
@@ -1,13 +1,24 @@
 #include <assert.h>
+#include <cstring>
 #include <functional>
 #include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
-#include "../src/orderbook.cc"
+#include "orderbook.h"
+#include "gateway.h"
+#include "client.h"
+#include "level_book.h"
+#include "ladder.h"
+#include "router.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "differential.h"
 
 using std::function;
 
-// TODO: write market order and cancel order tests
-
 TEST(OrderTest, TestOrderInitialize)
 {
     Order o{ 1, 1, true, 100, 0, 100454 };
@@ -45,35 +56,130 @@ TEST(LimitTest, TestLimitInitialize)
 
 TEST(LimitTest, TestLimitAddOrder)
 {
+    OrderPool pool;
     Limit l1{100454};
     Order o{ 1, 1, true, 100, 0, 100454 };
-    l1.addOrder(std::make_shared<Order>(o));
+    l1.addOrder(pool, pool.allocate(o));
 
     ASSERT_EQ(l1.size(), 1);
+    ASSERT_EQ(l1.total_volume(), 100);
 }
 
 TEST(LimitTest, TestLimitRemoveOrder)
 {
+    OrderPool pool;
     Limit l1{100454};
     Order o1{ 1, 1, true, 100, 0, 100454 };
-    Order o2{ 1, 1, true, 100, 0, 100454 };
-    Order o3{ 1, 1, true, 100, 0, 100454 };
+    Order o2{ 2, 1, true, 100, 0, 100454 };
+    Order o3{ 3, 1, true, 100, 0, 100454 };
 
-    shared_ptr<Order> o1p = std::make_shared<Order>(o1);
-    shared_ptr<Order> o2p = std::make_shared<Order>(o2);
-    shared_ptr<Order> o3p = std::make_shared<Order>(o3);
-    l1.addOrder(o1p);
-    l1.addOrder(o2p);
-    l1.addOrder(o3p);
+    uint32_t o1i = pool.allocate(o1);
+    uint32_t o2i = pool.allocate(o2);
+    uint32_t o3i = pool.allocate(o3);
+    l1.addOrder(pool, o1i);
+    l1.addOrder(pool, o2i);
+    l1.addOrder(pool, o3i);
 
-    l1.removeOrder(o2p);
+    l1.removeOrder(pool, o2i);
     ASSERT_EQ(l1.size(), 2);
+    ASSERT_EQ(pool[l1.head_order].next, o3i);
+    ASSERT_EQ(pool[o3i].prev, o1i);
 
-    l1.removeOrder(o1p);
+    l1.removeOrder(pool, o1i);
     ASSERT_EQ(l1.size(), 1);
+    ASSERT_EQ(l1.head_order, o3i);
 
-    l1.removeOrder(o3p);
+    l1.removeOrder(pool, o3i);
     ASSERT_EQ(l1.size(), 0);
+    ASSERT_EQ(l1.head_order, __NO_ORDER__);
+    ASSERT_EQ(l1.tail_order, __NO_ORDER__);
+}
+
+TEST(OrderPoolTest, TestSlotReuseAndLayout)
+{
+    OrderPool pool;
+    Order o1{ 1, 1, true, 100, 40, 100454, 9 };
+    Order o2{ 2, 1, false, 50, 0, 100455 };
+
+    uint32_t o1i = pool.allocate(o1);
+    uint32_t o2i = pool.allocate(o2);
+    ASSERT_EQ(pool[o1i].open_quantity, 60);
+    ASSERT_TRUE(pool[o1i].owned);
+    ASSERT_FALSE(pool[o2i].owned);
+    ASSERT_EQ(pool.info(o1i).quantity, 100);
+    ASSERT_EQ(pool.info(o1i).owner, 9);
+
+    // hot records never straddle a cache line
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(&pool[o1i]) % 32, 0);
+
+    pool.release(o1i);
+    ASSERT_EQ(pool.size(), 1);
+    Order o3{ 3, 1, true, 10, 0, 100456 };
+    ASSERT_EQ(pool.allocate(o3), o1i);
+    ASSERT_EQ(pool.capacity(), 2);
+
+    Order large{ 4, 1, true, (uint64_t)UINT32_MAX + 1, 0, 100456 };
+    ASSERT_THROW(pool.allocate(large), std::invalid_argument);
+}
+
+TEST(OrderPoolTest, TestChunkDrain)
+{
+    OrderPool pool;
+    std::vector<uint32_t> slots;
+    for (uint64_t i = 0; i < __POOL_CHUNK_SIZE__ + 10; i++)
+    {
+        Order o{ i + 1, 1, true, 10, 0, 100454 };
+        slots.push_back(pool.allocate(o));
+    }
+    ASSERT_EQ(pool.chunks(), 2);
+    size_t footprint = pool.footprint();
+
+    // a full chunk and a nearly empty one do not fit in one chunk
+    ASSERT_EQ(pool.nextToMove(), __NO_ORDER__);
+
+    for (size_t i = 0; i < 10; i++)
+    {
+        pool.release(slots[i]);
+    }
+
+    // the sparser second chunk drains into the first one's free slots
+    size_t moved = 0;
+    for (uint32_t index = pool.nextToMove(); index != __NO_ORDER__; index = pool.nextToMove())
+    {
+        ASSERT_GE(index, __POOL_CHUNK_SIZE__);
+        uint64_t id = pool[index].id;
+        uint32_t to = pool.move(index);
+        ASSERT_LT(to, __POOL_CHUNK_SIZE__);
+        ASSERT_EQ(pool[to].id, id);
+        moved++;
+    }
+    ASSERT_EQ(moved, 10);
+    ASSERT_EQ(pool.chunks(), 1);
+    ASSERT_EQ(pool.size(), __POOL_CHUNK_SIZE__);
+    ASSERT_LT(pool.footprint(), footprint);
+}
+
+TEST(OrderBookTest, TestOversizedOrderLeavesBookUntouched)
+{
+    OrderBook orderbook{0};
+    Order ask = orderbook.createLevelOrder(false, 10, 0, 101);
+    orderbook.addOrder(ask);
+
+    // rejected before matching, so the crossing ask keeps its quantity
+    Order large = orderbook.createLevelOrder(true, (uint64_t)UINT32_MAX + 11, 0, 101);
+    ASSERT_THROW(orderbook.addOrder(large), std::invalid_argument);
+    ASSERT_EQ(large.filled_quantity(), 0);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 10);
+    ASSERT_EQ(orderbook.inside_bid_price(), 0);
+    ASSERT_EQ(orderbook.size(), 1);
+
+    // nor does a resting order leave an empty level as the best price
+    orderbook.setAuctionMode(true);
+    Order resting = orderbook.createLevelOrder(true, 1ull << 33, 0, 100);
+    ASSERT_THROW(orderbook.addOrder(resting), std::invalid_argument);
+    ASSERT_EQ(orderbook.inside_bid_price(), 0);
+    ASSERT_EQ(orderbook.depthVolume(true, 1), 0);
+    ASSERT_EQ(orderbook.size(), 1);
 }
 
 TEST(OrderBookTest, TestOrderBookInitialize)
@@ -263,3 +369,1599 @@ TEST(OrderBookTest, TestFilledOrderProperties)
     ASSERT_EQ(o4.filled_cost(), 225000);
 }
 
+
+TEST(MarketDataTest, TestPublishTradeAndDepth)
+{
+    MarketDataPublisher publisher{"/orderbook_test_md_events"};
+    MarketDataReader reader{"/orderbook_test_md_events"};
+    OrderBook orderbook;
+    orderbook.setPublisher(&publisher);
+
+    Order o1 = orderbook.createOrder(false, 20, 0, 100);
+    Order o2 = orderbook.createOrder(true, 5, 0, 100);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+
+    MarketDataEvent event;
+    ASSERT_EQ(reader.read(event), MarketDataReadStatus::Ok);
+    ASSERT_EQ(event.type, MarketDataEventType::Depth);
+    ASSERT_EQ(event.is_bid, false);
+    ASSERT_EQ(event.price, 10000);
+    ASSERT_EQ(event.quantity, 20);
+    ASSERT_EQ(event.order_count, 1);
+
+    ASSERT_EQ(reader.read(event), MarketDataReadStatus::Ok);
+    ASSERT_EQ(event.type, MarketDataEventType::Trade);
+    ASSERT_EQ(event.quantity, 5);
+    ASSERT_EQ(event.maker_id, o1.id());
+    ASSERT_EQ(event.taker_id, o2.id());
+
+    ASSERT_EQ(reader.read(event), MarketDataReadStatus::Ok);
+    ASSERT_EQ(event.type, MarketDataEventType::Depth);
+    ASSERT_EQ(event.quantity, 15);
+    ASSERT_EQ(event.sequence, 3);
+
+    ASSERT_EQ(reader.read(event), MarketDataReadStatus::Empty);
+}
+
+TEST(MarketDataTest, TestOverrunResync)
+{
+    MarketDataPublisher publisher{"/orderbook_test_md_overrun", 4};
+    MarketDataReader reader{"/orderbook_test_md_overrun"};
+    OrderBook orderbook;
+    orderbook.setPublisher(&publisher);
+
+    for (int i = 1; i <= 6; i++)
+    {
+        Order o = orderbook.createOrder(true, 10, 0, 90 + i);
+        orderbook.addOrder(o);
+    }
+
+    MarketDataEvent event;
+    ASSERT_EQ(reader.read(event), MarketDataReadStatus::Overrun);
+
+    MarketDataSnapshot snapshot;
+    ASSERT_FALSE(reader.resync(snapshot));
+
+    orderbook.publishSnapshot();
+    ASSERT_TRUE(reader.resync(snapshot));
+    ASSERT_EQ(snapshot.sequence, 6);
+    ASSERT_EQ(snapshot.bid_count, 6);
+    ASSERT_EQ(snapshot.ask_count, 0);
+    ASSERT_EQ(snapshot.bids[0].price, 9600);
+
+    Order o = orderbook.createOrder(false, 10, 0, 96);
+    orderbook.addOrder(o);
+    ASSERT_EQ(reader.read(event), MarketDataReadStatus::Ok);
+    ASSERT_EQ(event.type, MarketDataEventType::Trade);
+    ASSERT_EQ(event.sequence, 7);
+}
+
+TEST(SPSCQueueTest, TestPushPopWrap)
+{
+    SPSCQueue<int, 4> queue;
+    int item;
+
+    ASSERT_FALSE(queue.pop(item));
+    for (int round = 0; round < 3; round++)
+    {
+        for (int i = 0; i < 4; i++)
+            ASSERT_TRUE(queue.push(round * 4 + i));
+        ASSERT_FALSE(queue.push(-1));
+
+        for (int i = 0; i < 4; i++)
+        {
+            ASSERT_TRUE(queue.pop(item));
+            ASSERT_EQ(item, round * 4 + i);
+        }
+        ASSERT_TRUE(queue.empty());
+    }
+}
+
+/* Sends orders to a gateway on loopback and collects one ack per order */
+std::vector<AckMessage> sendToGateway(uint16_t port, const std::vector<OrderMessage>& orders)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    EXPECT_EQ(connect(fd, (sockaddr*)&addr, sizeof(addr)), 0);
+
+    send(fd, orders.data(), orders.size() * sizeof(OrderMessage), 0);
+
+    std::vector<AckMessage> acks(orders.size());
+    size_t expected = orders.size() * sizeof(AckMessage);
+    size_t received = 0;
+    while (received < expected)
+    {
+        ssize_t n = recv(fd, (char*)acks.data() + received, expected - received, 0);
+        if (n <= 0)
+            break;
+        received += n;
+    }
+    close(fd);
+    return acks;
+}
+
+void testGatewayRoundTrip(bool use_io_uring)
+{
+    OrderBook orderbook;
+    Gateway gateway{orderbook, 0, use_io_uring};
+    std::thread server{&Gateway::run, &gateway};
+
+    std::vector<OrderMessage> orders{
+        {MessageType::NewOrder, false, 0, 20, 11, 10000, 1},
+        {MessageType::NewOrder, true, 0, 15, 12, 10000, 2},
+        {MessageType::NewOrder, true, 0, 0, 13, 10000, 3},
+        {(MessageType)9, true, 0, 10, 14, 10000, 4},
+        // would alias the 10000 level if it were not rejected
+        {MessageType::NewOrder, true, 0, 5, 15, (1ull << 32) + 10000, 5},
+    };
+    std::vector<AckMessage> acks = sendToGateway(gateway.port(), orders);
+
+    gateway.stop();
+    server.join();
+
+    ASSERT_EQ(acks[0].type, MessageType::Ack);
+    ASSERT_EQ(acks[0].client_id, 11);
+    ASSERT_EQ(acks[0].filled_quantity, 0);
+    ASSERT_EQ(acks[1].type, MessageType::Ack);
+    ASSERT_EQ(acks[1].filled_quantity, 15);
+    ASSERT_EQ(acks[1].sent_at, 2);
+    ASSERT_EQ(acks[2].type, MessageType::Reject);
+    ASSERT_EQ(acks[2].reason, RejectReason::InvalidOrder);
+    ASSERT_EQ(acks[3].type, MessageType::Reject);
+    ASSERT_EQ(acks[3].reason, RejectReason::UnknownType);
+    ASSERT_EQ(acks[4].type, MessageType::Reject);
+    ASSERT_EQ(acks[4].reason, RejectReason::InvalidOrder);
+
+    ASSERT_EQ(gateway.messages(), 5);
+    ASSERT_EQ(orderbook.size(), 1);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 5);
+}
+
+TEST(GatewayTest, TestEpollRoundTrip)
+{
+    testGatewayRoundTrip(false);
+}
+
+TEST(GatewayTest, TestIoUringRoundTrip)
+{
+    testGatewayRoundTrip(true);
+}
+
+/* Reads every trade published so far and returns the fill quantities */
+std::vector<uint64_t> readTradeQuantities(MarketDataReader& reader)
+{
+    std::vector<uint64_t> quantities;
+    MarketDataEvent event;
+    while (reader.read(event) == MarketDataReadStatus::Ok)
+    {
+        if (event.type == MarketDataEventType::Trade)
+            quantities.push_back(event.quantity);
+    }
+    return quantities;
+}
+
+TEST(ProRataTest, TestProportionalAllocation)
+{
+    MarketDataPublisher publisher{"/orderbook_test_pro_rata"};
+    MarketDataReader reader{"/orderbook_test_pro_rata"};
+    OrderBook orderbook{2, MatchingPolicy::ProRata};
+    orderbook.setPublisher(&publisher);
+
+    Order o1 = orderbook.createOrder(false, 100, 0, 100);
+    Order o2 = orderbook.createOrder(false, 200, 0, 100);
+    Order o3 = orderbook.createOrder(false, 700, 0, 100);
+    Order o4 = orderbook.createOrder(true, 500, 0, 100);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+    orderbook.addOrder(o3);
+    orderbook.addOrder(o4);
+
+    ASSERT_EQ(readTradeQuantities(reader), (std::vector<uint64_t>{50, 100, 350}));
+    ASSERT_EQ(o4.filled_quantity(), 500);
+    ASSERT_EQ(orderbook.size(), 3);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 50);
+}
+
+TEST(ProRataTest, TestRemainderInArrivalOrder)
+{
+    MarketDataPublisher publisher{"/orderbook_test_pro_rata_remainder"};
+    MarketDataReader reader{"/orderbook_test_pro_rata_remainder"};
+    OrderBook orderbook{2, MatchingPolicy::ProRata};
+    orderbook.setPublisher(&publisher);
+
+    for (int i = 0; i < 3; i++)
+    {
+        Order o = orderbook.createOrder(true, 1, 0, 100);
+        orderbook.addOrder(o);
+    }
+    Order o4 = orderbook.createOrder(false, 2, 0, 100);
+    orderbook.addOrder(o4);
+
+    // floor shares are all zero so the two lots go to the two oldest orders
+    ASSERT_EQ(readTradeQuantities(reader), (std::vector<uint64_t>{1, 1}));
+    ASSERT_EQ(orderbook.size(), 1);
+    ASSERT_EQ(orderbook.inside_bid_quantity(), 1);
+}
+
+TEST(ProRataTest, TestSweepAcrossLevels)
+{
+    OrderBook orderbook{2, MatchingPolicy::ProRata};
+
+    Order o1 = orderbook.createOrder(false, 10, 0, 90);
+    Order o2 = orderbook.createOrder(false, 30, 0, 100);
+    Order o3 = orderbook.createOrder(false, 10, 0, 100);
+    Order o4 = orderbook.createOrder(true, 30, 0, 100);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+    orderbook.addOrder(o3);
+    orderbook.addOrder(o4);
+
+    // 10 at 90 then 20 split 15 / 5 at 100
+    ASSERT_EQ(o4.filled_quantity(), 30);
+    ASSERT_EQ(o4.filled_cost(), 10 * 9000 + 20 * 10000);
+    ASSERT_EQ(orderbook.inside_ask_price(), 10000);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 15);
+    ASSERT_EQ(orderbook.size(), 2);
+}
+
+TEST(AuctionTest, TestOrdersRestWithoutMatching)
+{
+    OrderBook orderbook;
+    orderbook.setAuctionMode(true);
+
+    Order o1 = orderbook.createOrder(true, 10, 0, 101);
+    Order o2 = orderbook.createOrder(false, 10, 0, 99);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+
+    ASSERT_EQ(orderbook.size(), 2);
+    ASSERT_EQ(orderbook.inside_bid_price(), 10100);
+    ASSERT_EQ(orderbook.inside_ask_price(), 9900);
+}
+
+TEST(AuctionTest, TestEquilibriumPrice)
+{
+    OrderBook orderbook;
+    orderbook.setAuctionMode(true);
+
+    // bids: 10 @ 102, 20 @ 101, 30 @ 99; asks: 15 @ 98, 10 @ 100, 40 @ 101
+    std::vector<Order> orders{
+        orderbook.createOrder(true, 10, 0, 102),
+        orderbook.createOrder(true, 20, 0, 101),
+        orderbook.createOrder(true, 30, 0, 99),
+        orderbook.createOrder(false, 15, 0, 98),
+        orderbook.createOrder(false, 10, 0, 100),
+        orderbook.createOrder(false, 40, 0, 101),
+    };
+    for (Order& o : orders)
+        orderbook.addOrder(o);
+
+    // executable volume is 15 at 99, 25 at 100 and 30 at 101
+    AuctionResult indicative = orderbook.indicativeUncross();
+    ASSERT_EQ(indicative.price, 10100);
+    ASSERT_EQ(indicative.volume, 30);
+
+    AuctionResult result = orderbook.uncross();
+    ASSERT_EQ(result.price, 10100);
+    ASSERT_EQ(result.volume, 30);
+
+    // bids at 102 and 101 are gone, 35 of the 101 ask is left
+    ASSERT_EQ(orderbook.inside_bid_price(), 9900);
+    ASSERT_EQ(orderbook.inside_bid_quantity(), 30);
+    ASSERT_EQ(orderbook.inside_ask_price(), 10100);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 35);
+    ASSERT_EQ(orderbook.size(), 2);
+    ASSERT_EQ(orderbook.indicativeUncross().volume, 0);
+}
+
+TEST(AuctionTest, TestImbalanceTieBreak)
+{
+    OrderBook orderbook;
+    orderbook.setAuctionMode(true);
+
+    // 10 executes at both 100 and 102; 102 leaves the smaller imbalance
+    std::vector<Order> orders{
+        orderbook.createOrder(true, 10, 0, 102),
+        orderbook.createOrder(true, 8, 0, 100),
+        orderbook.createOrder(false, 10, 0, 100),
+        orderbook.createOrder(false, 5, 0, 102),
+    };
+    for (Order& o : orders)
+        orderbook.addOrder(o);
+
+    AuctionResult result = orderbook.indicativeUncross();
+    ASSERT_EQ(result.volume, 10);
+    ASSERT_EQ(result.price, 10200);
+}
+
+TEST(AuctionTest, TestLeavingAuctionUncrosses)
+{
+    OrderBook orderbook;
+    orderbook.setAuctionMode(true);
+
+    Order o1 = orderbook.createOrder(false, 10, 0, 99);
+    Order o2 = orderbook.createOrder(true, 15, 0, 101);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+    orderbook.setAuctionMode(false);
+
+    ASSERT_FALSE(orderbook.auction_mode());
+    ASSERT_EQ(orderbook.size(), 1);
+    ASSERT_EQ(orderbook.inside_ask_price(), 0);
+    ASSERT_EQ(orderbook.inside_bid_quantity(), 5);
+
+    // continuous matching resumes on the uncrossed book
+    Order o3 = orderbook.createOrder(false, 5, 0, 101);
+    orderbook.addOrder(o3);
+    ASSERT_EQ(orderbook.size(), 0);
+}
+
+TEST(ArenaTest, TestAllocateReuse)
+{
+    Arena arena{__HUGE_PAGE_SIZE__};
+    ASSERT_EQ(arena.reserved(), __HUGE_PAGE_SIZE__);
+
+    void* a = arena.allocate(40);
+    void* b = arena.allocate(40);
+    ASSERT_NE(a, b);
+    ASSERT_EQ((uintptr_t)a % 16, 0);
+    ASSERT_EQ(arena.used(), 128);
+
+    // freed blocks are handed back out for the same size class
+    arena.deallocate(a, 40);
+    ASSERT_EQ(arena.allocate(33), a);
+
+    // a request larger than the chunk maps a new one
+    arena.allocate(__HUGE_PAGE_SIZE__ * 2);
+    ASSERT_EQ(arena.reserved(), __HUGE_PAGE_SIZE__ * 3);
+}
+
+TEST(ArenaTest, TestOrderBookArena)
+{
+    Arena arena{__HUGE_PAGE_SIZE__};
+    {
+        OrderBook orderbook{2, MatchingPolicy::PriceTime, &arena};
+
+        Order o1 = orderbook.createOrder(false, 20, 0, 100);
+        Order o2 = orderbook.createOrder(false, 10, 0, 101);
+        Order o3 = orderbook.createOrder(true, 25, 0, 101);
+        orderbook.addOrder(o1);
+        orderbook.addOrder(o2);
+        ASSERT_GT(arena.used(), 0);
+
+        orderbook.addOrder(o3);
+        ASSERT_EQ(orderbook.size(), 1);
+        ASSERT_EQ(orderbook.inside_ask_price(), 10100);
+        ASSERT_EQ(orderbook.inside_ask_quantity(), 5);
+    }
+}
+
+TEST(StatisticsTest, TestSessionStatistics)
+{
+    OrderBook orderbook;
+
+    Order o1 = orderbook.createOrder(false, 10, 0, 100);
+    Order o2 = orderbook.createOrder(false, 10, 0, 102);
+    Order o3 = orderbook.createOrder(true, 15, 0, 102);
+    Order o4 = orderbook.createOrder(false, 5, 0, 99);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+    orderbook.addOrder(o3);
+    orderbook.addOrder(o4);
+
+    // 10 @ 100 and 5 @ 102; the last ask finds no bids and rests
+    const TradeSummary& session = orderbook.session_statistics();
+    ASSERT_EQ(session.trade_count, 2);
+    ASSERT_EQ(session.open, 10000);
+    ASSERT_EQ(session.high, 10200);
+    ASSERT_EQ(session.low, 10000);
+    ASSERT_EQ(session.last, 10200);
+    ASSERT_EQ(session.volume, 15);
+    ASSERT_EQ(session.notional, 10 * 10000 + 5 * 10200);
+    ASSERT_DOUBLE_EQ(session.vwap(), (10 * 10000 + 5 * 10200) / 15.0);
+
+    orderbook.resetSession();
+    ASSERT_EQ(orderbook.session_statistics().trade_count, 0);
+}
+
+TEST(StatisticsTest, TestRollingWindow)
+{
+    OrderBook orderbook;
+    orderbook.setStatisticsWindow(10000);
+
+    // created_at drives the rolling window: trades at t=1s and t=8s
+    Order a1{1, 0, false, 10, 0, 10000};
+    Order b1{2, 1000, true, 10, 0, 10000};
+    Order a2{3, 0, false, 20, 0, 10100};
+    Order b2{4, 8000, true, 20, 0, 10100};
+    orderbook.addOrder(a1);
+    orderbook.addOrder(b1);
+    orderbook.addOrder(a2);
+    orderbook.addOrder(b2);
+
+    TradeSummary both = orderbook.rolling_statistics(9000);
+    ASSERT_EQ(both.trade_count, 2);
+    ASSERT_EQ(both.open, 10000);
+    ASSERT_EQ(both.last, 10100);
+    ASSERT_EQ(both.volume, 30);
+
+    // by t=12s the first trade has left the window
+    TradeSummary recent = orderbook.rolling_statistics(12000);
+    ASSERT_EQ(recent.trade_count, 1);
+    ASSERT_EQ(recent.open, 10100);
+    ASSERT_EQ(recent.low, 10100);
+    ASSERT_EQ(recent.volume, 20);
+
+    ASSERT_EQ(orderbook.rolling_statistics(30000).trade_count, 0);
+    ASSERT_EQ(orderbook.session_statistics().trade_count, 2);
+}
+
+TEST(MassCancelTest, TestCancelByOwner)
+{
+    MarketDataPublisher publisher{"/orderbook_test_mass_cancel"};
+    MarketDataReader reader{"/orderbook_test_mass_cancel"};
+    OrderBook orderbook;
+    orderbook.setPublisher(&publisher);
+
+    std::vector<Order> orders{
+        orderbook.createOrder(true, 10, 0, 99, 7),
+        orderbook.createOrder(true, 10, 0, 98, 8),
+        orderbook.createOrder(true, 10, 0, 98, 7),
+        orderbook.createOrder(false, 10, 0, 101, 7),
+        orderbook.createOrder(false, 10, 0, 102, 8),
+    };
+    for (Order& o : orders)
+        orderbook.addOrder(o);
+    readTradeQuantities(reader);
+
+    MassCancelResult result = orderbook.cancelOwnerOrders(7);
+    ASSERT_EQ(result.orders, 3);
+    ASSERT_EQ(result.volume, 30);
+    ASSERT_EQ(orderbook.size(), 2);
+    ASSERT_EQ(orderbook.inside_bid_price(), 9800);
+    ASSERT_EQ(orderbook.inside_ask_price(), 10200);
+
+    // one depth update per level then a single mass-cancel event
+    MarketDataEvent event;
+    int depth_events = 0;
+    while (reader.read(event) == MarketDataReadStatus::Ok && event.type == MarketDataEventType::Depth)
+        depth_events++;
+    ASSERT_EQ(depth_events, 3);
+    ASSERT_EQ(event.type, MarketDataEventType::MassCancel);
+    ASSERT_EQ(event.maker_id, 7);
+    ASSERT_EQ(event.order_count, 3);
+
+    ASSERT_EQ(orderbook.cancelOwnerOrders(7).orders, 0);
+
+    // reclaimed levels can be recreated at the inside
+    Order o = orderbook.createOrder(true, 5, 0, 99, 7);
+    orderbook.addOrder(o);
+    ASSERT_EQ(orderbook.inside_bid_price(), 9900);
+}
+
+TEST(MassCancelTest, TestFilledOrdersLeaveOwnerList)
+{
+    OrderBook orderbook;
+
+    Order o1 = orderbook.createOrder(false, 10, 0, 100, 7);
+    Order o2 = orderbook.createOrder(false, 10, 0, 100, 7);
+    Order o3 = orderbook.createOrder(true, 15, 0, 100, 8);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+    orderbook.addOrder(o3);
+
+    MassCancelResult result = orderbook.cancelOwnerOrders(7);
+    ASSERT_EQ(result.orders, 1);
+    ASSERT_EQ(result.volume, 5);
+    ASSERT_EQ(orderbook.size(), 0);
+    ASSERT_EQ(orderbook.inside_ask_price(), 0);
+}
+
+TEST(MassCancelTest, TestCancelPriceRangeAndSide)
+{
+    OrderBook orderbook;
+
+    for (int price = 100; price <= 103; price++)
+    {
+        Order o = orderbook.createOrder(false, 10, 0, price);
+        orderbook.addOrder(o);
+    }
+    Order bid = orderbook.createOrder(true, 10, 0, 90);
+    orderbook.addOrder(bid);
+
+    MassCancelResult result = orderbook.cancelPriceRange(false, 10100, 10200);
+    ASSERT_EQ(result.orders, 2);
+    ASSERT_EQ(orderbook.size(), 3);
+    ASSERT_EQ(orderbook.inside_ask_price(), 10000);
+
+    // levels removed from the middle are unlinked from the ask side
+    Order sweep = orderbook.createOrder(true, 10, 0, 100);
+    orderbook.addOrder(sweep);
+    ASSERT_EQ(orderbook.inside_ask_price(), 10300);
+
+    result = orderbook.cancelSide(true);
+    ASSERT_EQ(result.orders, 1);
+    ASSERT_EQ(orderbook.inside_bid_price(), 0);
+    ASSERT_EQ(orderbook.size(), 1);
+}
+
+TEST(DepthTest, TestCumulativeDepthAndBand)
+{
+    OrderBook orderbook{0};
+
+    for (int price = 100; price <= 104; price++)
+    {
+        Order o = orderbook.createLevelOrder(false, 10 * (price - 99), 0, price);
+        orderbook.addOrder(o);
+    }
+    Order bid = orderbook.createLevelOrder(true, 7, 0, 95);
+    orderbook.addOrder(bid);
+
+    ASSERT_EQ(orderbook.depthVolume(false, 0), 0);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 10);
+    ASSERT_EQ(orderbook.depthVolume(false, 3), 60);
+    ASSERT_EQ(orderbook.depthVolume(false, 10), 150);
+    ASSERT_EQ(orderbook.depthVolume(true, 2), 7);
+
+    ASSERT_EQ(orderbook.volumeInBand(false, 101, 102), 50);
+    ASSERT_EQ(orderbook.volumeInBand(false, 90, 100), 10);
+    ASSERT_EQ(orderbook.volumeInBand(false, 105, 110), 0);
+    ASSERT_EQ(orderbook.volumeInBand(true, 90, 100), 7);
+    ASSERT_THROW(orderbook.volumeInBand(false, 102, 101), std::invalid_argument);
+
+    // a change beyond the cached levels leaves the inside cached and correct
+    Order deep = orderbook.createLevelOrder(false, 5, 0, 103);
+    orderbook.addOrder(deep);
+    ASSERT_EQ(orderbook.depthVolume(false, 4), 105);
+
+    // a fill at the inside invalidates every cached level
+    Order sweep = orderbook.createLevelOrder(true, 15, 0, 101);
+    orderbook.addOrder(sweep);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 15);
+    ASSERT_EQ(orderbook.depthVolume(false, 3), 90);
+    ASSERT_EQ(orderbook.volumeInBand(false, 100, 103), 90);
+}
+
+TEST(DepthTest, TestEstimateFill)
+{
+    OrderBook orderbook{0};
+
+    Order o1 = orderbook.createLevelOrder(false, 10, 0, 100);
+    Order o2 = orderbook.createLevelOrder(false, 20, 0, 102);
+    Order o3 = orderbook.createLevelOrder(true, 5, 0, 90);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+    orderbook.addOrder(o3);
+
+    FillEstimate estimate = orderbook.estimateFill(true, 20);
+    ASSERT_EQ(estimate.quantity, 20);
+    ASSERT_EQ(estimate.cost, 10 * 100 + 10 * 102);
+    ASSERT_EQ(estimate.worst_price, 102);
+    ASSERT_DOUBLE_EQ(estimate.average_price(), 101);
+
+    // capped at the available depth
+    estimate = orderbook.estimateFill(true, 100);
+    ASSERT_EQ(estimate.quantity, 30);
+    ASSERT_EQ(estimate.worst_price, 102);
+
+    estimate = orderbook.estimateFill(false, 3);
+    ASSERT_EQ(estimate.quantity, 3);
+    ASSERT_EQ(estimate.worst_price, 90);
+
+    // the estimate matches the fills of an order that sweeps the same quantity
+    Order sweep = orderbook.createLevelOrder(true, 20, 0, 102);
+    orderbook.addOrder(sweep);
+    ASSERT_EQ(orderbook.session_statistics().notional, 10 * 100 + 10 * 102);
+    ASSERT_EQ(orderbook.estimateFill(true, 20).cost, 10 * 102);
+    ASSERT_EQ(orderbook.estimateFill(true, 20).quantity, 10);
+}
+
+TEST(LevelBookTest, TestApplyLevelUpdates)
+{
+    MBPBook book;
+
+    book.applyLevel(false, 102, 30, 2);
+    book.applyLevel(false, 100, 10, 1);
+    book.applyLevel(false, 101, 20, 1);
+    book.applyLevel(true, 98, 5, 1);
+    book.applyLevel(true, 99, 7, 2);
+
+    ASSERT_EQ(book.inside_ask_price(), 100);
+    ASSERT_EQ(book.inside_bid_price(), 99);
+    ASSERT_EQ(book.inside_bid_volume(), 7);
+    ASSERT_EQ(book.size(false), 3);
+
+    const PriceLevel* level = book.best(false);
+    ASSERT_EQ(level->next->price(), 101);
+    ASSERT_EQ(level->next->next->price(), 102);
+
+    // modify in place, then delete the inside and a middle level
+    book.applyLevel(false, 101, 25, 2);
+    ASSERT_EQ(book.level(false, 101)->total_volume(), 25);
+    ASSERT_EQ(book.level(false, 101)->size(), 2);
+
+    book.applyLevel(false, 100, 0, 0);
+    ASSERT_EQ(book.inside_ask_price(), 101);
+    book.deleteLevel(true, 98);
+    ASSERT_EQ(book.best(true)->next, nullptr);
+    ASSERT_EQ(book.level(true, 98), nullptr);
+
+    book.deleteLevel(false, 101);
+    ASSERT_EQ(book.best(false)->price(), 102);
+    ASSERT_EQ(book.best(false)->prev, nullptr);
+}
+
+TEST(LevelBookTest, TestMirrorsPublishedDepth)
+{
+    MarketDataPublisher publisher{"/orderbook_test_md_mbp"};
+    MarketDataReader reader{"/orderbook_test_md_mbp"};
+    OrderBook orderbook{0};
+    orderbook.setPublisher(&publisher);
+
+    for (int i = 0; i < 40; i++)
+    {
+        Order o = orderbook.createLevelOrder(i % 2 == 0, 10 + i, 0, 95 + (i * 7) % 11);
+        orderbook.addOrder(o);
+    }
+
+    MBPBook book;
+    MarketDataEvent event;
+    while (reader.read(event) == MarketDataReadStatus::Ok)
+    {
+        book.apply(event);
+    }
+
+    ASSERT_GT(book.size(true) + book.size(false), 0);
+    ASSERT_EQ(book.inside_bid_price(), orderbook.inside_bid_price());
+    ASSERT_EQ(book.inside_ask_price(), orderbook.inside_ask_price());
+    for (int i = 1; i <= 5; i++)
+    {
+        uint64_t bid_volume = 0;
+        uint64_t ask_volume = 0;
+        const PriceLevel* bid = book.best(true);
+        const PriceLevel* ask = book.best(false);
+        for (int level = 0; level < i; level++)
+        {
+            if (bid != nullptr) { bid_volume += bid->total_volume(); bid = bid->next; }
+            if (ask != nullptr) { ask_volume += ask->total_volume(); ask = ask->next; }
+        }
+        ASSERT_EQ(bid_volume, orderbook.depthVolume(true, i));
+        ASSERT_EQ(ask_volume, orderbook.depthVolume(false, i));
+    }
+
+    // a snapshot rebuilds the same book
+    orderbook.publishSnapshot();
+    MarketDataSnapshot snapshot;
+    ASSERT_TRUE(reader.resync(snapshot));
+    MBPBook rebuilt;
+    rebuilt.apply(snapshot);
+    ASSERT_EQ(rebuilt.size(true), book.size(true));
+    ASSERT_EQ(rebuilt.size(false), book.size(false));
+    ASSERT_EQ(rebuilt.inside_ask_volume(), book.inside_ask_volume());
+}
+
+TEST(OrderBookTest, TestCancelReduceExecuteReplace)
+{
+    OrderBook orderbook{0};
+
+    Order o1 = orderbook.createLevelOrder(false, 30, 0, 100);
+    Order o2 = orderbook.createLevelOrder(false, 10, 0, 101);
+    Order o3 = orderbook.createLevelOrder(true, 10, 0, 90);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+    orderbook.addOrder(o3);
+
+    ASSERT_EQ(orderbook.reduceOrder(o1.id(), 5), 5);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 25);
+
+    ASSERT_EQ(orderbook.executeOrder(o1.id(), 10), 10);
+    ASSERT_EQ(orderbook.session_statistics().volume, 10);
+    ASSERT_EQ(orderbook.session_statistics().last, 100);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 15);
+
+    // executing more than remains takes the order and its level out
+    ASSERT_EQ(orderbook.executeOrder(o1.id(), 50, 99), 15);
+    ASSERT_EQ(orderbook.session_statistics().last, 99);
+    ASSERT_EQ(orderbook.inside_ask_price(), 101);
+    ASSERT_EQ(orderbook.size(), 2);
+    ASSERT_EQ(orderbook.executeOrder(o1.id(), 1), 0);
+
+    ASSERT_EQ(orderbook.replaceOrder(o3.id(), 1000, 20, 95), 20);
+    ASSERT_EQ(orderbook.inside_bid_price(), 95);
+    ASSERT_EQ(orderbook.sendCancelOrder(o3.id()), 0);
+    ASSERT_EQ(orderbook.sendCancelOrder(1000), 20);
+    ASSERT_EQ(orderbook.inside_bid_price(), 0);
+    ASSERT_EQ(orderbook.size(), 1);
+}
+
+TEST(ReplayTest, TestItchRoundTrip)
+{
+    ItchMessage add;
+    std::memset(&add, 0, sizeof(add));
+    add.type = ItchMessageType::AddOrder;
+    add.stock_locate = 7;
+    add.timestamp = 34200000000000;
+    add.order_ref = 123456789;
+    add.is_bid = true;
+    add.shares = 300;
+    add.price = 1002500;
+    std::memcpy(add.symbol, "AAPL    ", __ITCH_SYMBOL_LENGTH__);
+
+    ItchMessage replace;
+    std::memset(&replace, 0, sizeof(replace));
+    replace.type = ItchMessageType::OrderReplace;
+    replace.stock_locate = 7;
+    replace.order_ref = 123456789;
+    replace.new_order_ref = 123456790;
+    replace.shares = 200;
+    replace.price = 1002400;
+
+    std::vector<uint8_t> data;
+    encodeItchMessage(add, data);
+    encodeItchMessage(replace, data);
+    ASSERT_EQ(data.size(), 2 + 36 + 2 + 35);
+
+    size_t offset = 0;
+    const uint8_t* body;
+    uint16_t length;
+    ItchMessage decoded;
+    ASSERT_TRUE(nextItchMessage(data.data(), data.size(), offset, body, length));
+    ASSERT_TRUE(decodeItchMessage(body, length, decoded));
+    ASSERT_EQ(decoded.type, ItchMessageType::AddOrder);
+    ASSERT_EQ(decoded.stock_locate, 7);
+    ASSERT_EQ(decoded.timestamp, 34200000000000);
+    ASSERT_EQ(decoded.order_ref, 123456789);
+    ASSERT_TRUE(decoded.is_bid);
+    ASSERT_EQ(decoded.shares, 300);
+    ASSERT_EQ(decoded.price, 1002500);
+    ASSERT_EQ(itchSymbol(decoded), "AAPL");
+
+    ASSERT_TRUE(nextItchMessage(data.data(), data.size(), offset, body, length));
+    ASSERT_TRUE(decodeItchMessage(body, length, decoded));
+    ASSERT_EQ(decoded.new_order_ref, 123456790);
+    ASSERT_EQ(decoded.price, 1002400);
+    ASSERT_FALSE(nextItchMessage(data.data(), data.size(), offset, body, length));
+
+    // unknown types are skipped and truncated known types rejected
+    uint8_t system_event[12] = {'S'};
+    ASSERT_FALSE(decodeItchMessage(system_event, sizeof(system_event), decoded));
+    ASSERT_THROW(decodeItchMessage(data.data() + 2, 20, decoded), std::runtime_error);
+}
+
+TEST(ReplayTest, TestReplayMatchesAcrossThreadCounts)
+{
+    std::vector<uint8_t> data = generateItchMessages(20000, 5);
+
+    ReplayResult single = ReplayEngine{1}.run(data.data(), data.size());
+    ReplayResult parallel = ReplayEngine{3}.run(data.data(), data.size());
+
+    ASSERT_EQ(single.messages, 20000);
+    ASSERT_EQ(single.applied, 20000);
+    ASSERT_EQ(single.symbols.size(), 5);
+    ASSERT_EQ(single.checksum, parallel.checksum);
+    ASSERT_EQ(single.symbols[0].symbol, "SYM1");
+
+    uint64_t messages = 0;
+    for (size_t i = 0; i < single.symbols.size(); i++)
+    {
+        const SymbolSummary& symbol = single.symbols[i];
+        messages += symbol.messages;
+        ASSERT_EQ(symbol.orders, parallel.symbols[i].orders);
+        ASSERT_GT(symbol.trade_count, 0);
+        // the generated feed never crosses
+        ASSERT_LT(symbol.bid_price, symbol.ask_price);
+    }
+    ASSERT_EQ(messages, 20000);
+
+    // a file cut inside a message is rejected
+    ASSERT_THROW(ReplayEngine{2}.run(data.data(), data.size() - 1), std::runtime_error);
+}
+
+TEST(OrderBookTest, TestMarketOrder)
+{
+    OrderBook orderbook{0};
+
+    Order o1 = orderbook.createLevelOrder(true, 10, 0, 100);
+    Order o2 = orderbook.createLevelOrder(true, 10, 0, 99);
+    orderbook.addOrder(o1);
+    orderbook.addOrder(o2);
+
+    // sells fill at the resting bid prices and never rest
+    ASSERT_EQ(orderbook.sendMarketOrder(false, 15), 15);
+    ASSERT_EQ(orderbook.session_statistics().notional, 10 * 100 + 5 * 99);
+    ASSERT_EQ(orderbook.inside_bid_price(), 99);
+    ASSERT_EQ(orderbook.sendMarketOrder(false, 20), 5);
+    ASSERT_EQ(orderbook.size(), 0);
+    ASSERT_EQ(orderbook.inside_ask_price(), 0);
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 5), 0);
+}
+
+TEST(DifferentialTest, TestMatchesReferenceBook)
+{
+    DifferentialResult result = runDifferential(50000, 7, "/orderbook_test_differential");
+    ASSERT_TRUE(result.matched) << result.mismatch;
+    ASSERT_GT(result.fills, 0);
+}
+
+TEST(PeggedOrderTest, TestGroupsFollowBBO)
+{
+    OrderBook orderbook{0};
+    ASSERT_THROW(orderbook.addPeggedOrder(true, 10, PegType::Primary, 1), std::invalid_argument);
+
+    // pegs without a reference are inactive and do not match
+    uint64_t peg = orderbook.addPeggedOrder(false, 10, PegType::Mid);
+    Order bid = orderbook.createLevelOrder(true, 10, 0, 100);
+    orderbook.addOrder(bid);
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 5), 0);
+
+    Order ask = orderbook.createLevelOrder(false, 10, 0, 104);
+    orderbook.addOrder(ask);
+    ASSERT_EQ(orderbook.pegPrice(true, PegType::Mid, 0), 101);
+    ASSERT_EQ(orderbook.pegPrice(false, PegType::Mid, 0), 103);
+    ASSERT_EQ(orderbook.pegPrice(true, PegType::Primary, -2), 98);
+
+    // a whole group moves with the BBO
+    for (int i = 0; i < 1000; i++)
+    {
+        orderbook.addPeggedOrder(true, 1, PegType::Primary, -1);
+    }
+    Order better = orderbook.createLevelOrder(true, 10, 0, 102);
+    orderbook.addOrder(better);
+    ASSERT_EQ(orderbook.inside_bid_price(), 102);
+    ASSERT_EQ(orderbook.pegPrice(false, PegType::Mid, 0), 104);
+
+    // sweep bids: 102 limit, 101 group of pegs, then the 100 limit
+    ASSERT_EQ(orderbook.sendMarketOrder(false, 1015), 1015);
+    ASSERT_EQ(orderbook.session_statistics().notional, 10 * 102 + 1000 * 101 + 5 * 100);
+    ASSERT_EQ(orderbook.size(), 3);
+
+    // pegged orders are not displayed
+    ASSERT_EQ(orderbook.depthVolume(true, 1), 5);
+    ASSERT_EQ(orderbook.sendCancelOrder(peg), 10);
+}
+
+TEST(PeggedOrderTest, TestPriorityAndCancel)
+{
+    OrderBook orderbook{0};
+
+    Order ask = orderbook.createLevelOrder(false, 10, 0, 100);
+    orderbook.addOrder(ask);
+    uint64_t first = orderbook.addPeggedOrder(false, 10, PegType::Primary, 0, 7);
+    uint64_t second = orderbook.addPeggedOrder(false, 10, PegType::Primary, 0, 7);
+    uint64_t wide = orderbook.addPeggedOrder(false, 10, PegType::Primary, 1);
+    Order late = orderbook.createLevelOrder(false, 10, 0, 100);
+    orderbook.addOrder(late);
+
+    // limit orders first at a price, then pegs in arrival order
+    Order buy = orderbook.createLevelOrder(true, 25, 0, 100);
+    orderbook.addOrder(buy);
+    ASSERT_EQ(orderbook.inside_ask_price(), 0);
+    ASSERT_EQ(orderbook.reduceOrder(first, 100), 5);
+    ASSERT_EQ(orderbook.size(), 2);
+
+    // the best ask moved away so the groups reprice, keeping their queues
+    Order away = orderbook.createLevelOrder(false, 10, 0, 105);
+    orderbook.addOrder(away);
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 12), 12);
+    ASSERT_EQ(orderbook.session_statistics().notional, 25 * 100 + 10 * 105 + 2 * 105);
+    Order again = orderbook.createLevelOrder(false, 10, 0, 105);
+    orderbook.addOrder(again);
+    ASSERT_EQ(orderbook.executeOrder(wide, 3), 3);
+    ASSERT_EQ(orderbook.session_statistics().last, 106);
+
+    MassCancelResult result = orderbook.cancelOwnerOrders(7);
+    ASSERT_EQ(result.orders, 1);
+    ASSERT_EQ(result.volume, 8);
+    ASSERT_EQ(orderbook.reduceOrder(second, 1), 0);
+    result = orderbook.cancelSide(false);
+    ASSERT_EQ(result.orders, 2);
+    ASSERT_EQ(result.volume, 17);
+    ASSERT_EQ(orderbook.size(), 0);
+}
+
+TEST(IcebergOrderTest, TestTranchesRequeueInPlace)
+{
+    MarketDataPublisher publisher{"/orderbook_test_iceberg"};
+    MarketDataReader reader{"/orderbook_test_iceberg"};
+    OrderBook orderbook{0};
+    orderbook.setPublisher(&publisher);
+    ASSERT_THROW(orderbook.createIcebergOrder(false, 10, 10, 100), std::invalid_argument);
+    ASSERT_THROW(orderbook.createIcebergOrder(false, 10, 0, 100), std::invalid_argument);
+
+    Order iceberg = orderbook.createIcebergOrder(false, 100, 10, 100, 5);
+    orderbook.addOrder(iceberg);
+    Order plain = orderbook.createLevelOrder(false, 10, 0, 100);
+    orderbook.addOrder(plain);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 20);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 10);
+
+    // the emptied tranche refills behind the plain order
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 15), 15);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 15);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 5);
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 5), 5);
+    ASSERT_EQ(orderbook.size(), 1);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 10);
+
+    // a sweep keeps refilling the same order until it has taken enough
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 35), 35);
+    ASSERT_EQ(orderbook.session_statistics().trade_count, 7);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 5);
+
+    // reductions come out of the reserve first, so the tranche keeps its place
+    Order behind = orderbook.createLevelOrder(false, 7, 0, 100);
+    orderbook.addOrder(behind);
+    ASSERT_EQ(orderbook.reduceOrder(iceberg.id(), 10), 10);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 12);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 5);
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 5), 5);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 7);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 17);
+
+    // once the reserve is used up the rest comes off the shown tranche
+    ASSERT_EQ(orderbook.reduceOrder(iceberg.id(), 32), 32);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 15);
+    ASSERT_EQ(orderbook.reduceOrder(iceberg.id(), 5), 5);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 10);
+
+    readTradeQuantities(reader);
+    ASSERT_EQ(orderbook.reduceOrder(behind.id(), 4), 4);
+    Order reserve = orderbook.createIcebergOrder(false, 50, 5, 100, 5);
+    orderbook.addOrder(reserve);
+    MassCancelResult cancelled = orderbook.cancelOwnerOrders(5);
+    ASSERT_EQ(cancelled.orders, 2);
+    ASSERT_EQ(cancelled.volume, 53);
+    ASSERT_EQ(cancelled.hidden, 45);
+    ASSERT_EQ(orderbook.size(), 1);
+    ASSERT_EQ(orderbook.inside_ask_quantity(), 3);
+
+    // the feed sees the shown tranches only, never the reserve
+    MarketDataEvent event;
+    uint64_t level = 0;
+    while (reader.read(event) == MarketDataReadStatus::Ok && event.type == MarketDataEventType::Depth)
+        level = event.quantity;
+    ASSERT_EQ(level, 3);
+    ASSERT_EQ(event.type, MarketDataEventType::MassCancel);
+    ASSERT_EQ(event.quantity, 8);
+}
+
+TEST(IcebergOrderTest, TestAuctionAndProRata)
+{
+    // auctions see the hidden reserve
+    OrderBook auction{0};
+    auction.setAuctionMode(true);
+    Order bid = auction.createIcebergOrder(true, 50, 5, 100);
+    auction.addOrder(bid);
+    Order ask = auction.createLevelOrder(false, 30, 0, 100);
+    auction.addOrder(ask);
+    ASSERT_EQ(auction.indicativeUncross().volume, 30);
+    auction.setAuctionMode(false);
+    ASSERT_EQ(auction.size(), 1);
+    ASSERT_EQ(auction.depthVolume(true, 1), 5);
+    ASSERT_EQ(auction.replaceOrder(bid.id(), 1000, 40, 101), 40);
+    ASSERT_EQ(auction.depthVolume(true, 1), 5);
+    ASSERT_EQ(auction.sendCancelOrder(1000), 40);
+
+    // pro-rata splits by shown quantity
+    OrderBook orderbook{0, MatchingPolicy::ProRata};
+    Order iceberg = orderbook.createIcebergOrder(false, 100, 10, 100);
+    orderbook.addOrder(iceberg);
+    Order plain = orderbook.createLevelOrder(false, 30, 0, 100);
+    orderbook.addOrder(plain);
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 20), 20);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 20);
+    ASSERT_EQ(orderbook.sendMarketOrder(true, 20), 20);
+    ASSERT_EQ(orderbook.size(), 1);
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 10);
+    ASSERT_EQ(orderbook.sendCancelOrder(iceberg.id()), 90);
+}
+
+TEST(SnapshotTest, TestCopyOnWriteMatchesSequence)
+{
+    OrderBook orderbook{0};
+    SnapshotCoordinator snapshots{1, 1};
+    SnapshotChannel& channel = snapshots.channel(0);
+    channel.addBook(42, orderbook);
+    ASSERT_THROW(snapshots.wait(), std::logic_error);
+
+    std::mt19937_64 gen{11};
+    std::vector<uint64_t> ids;
+    std::vector<MarketDataLevel> bids;
+    std::vector<MarketDataLevel> asks;
+    ASSERT_TRUE(snapshots.request(300));
+    ASSERT_FALSE(snapshots.request(400));
+    for (uint64_t sequence = 1; sequence <= 600; sequence++)
+    {
+        channel.advance(sequence);
+        if (sequence == 301)
+        {
+            // expected state as of the snapshot sequence, read directly
+            for (const DepthLevel& level : orderbook.depth(true, SIZE_MAX))
+                bids.push_back(MarketDataLevel{level.price, level.volume, level.limit->size()});
+            for (const DepthLevel& level : orderbook.depth(false, SIZE_MAX))
+                asks.push_back(MarketDataLevel{level.price, level.volume, level.limit->size()});
+        }
+
+        int roll = gen() % 10;
+        if (roll < 6 || ids.empty())
+        {
+            bool is_bid = gen() % 2 == 0;
+            uint64_t price = is_bid ? 100 - gen() % 40 : 101 + gen() % 40;
+            Order order = orderbook.createLevelOrder(is_bid, 1 + gen() % 10, 0, price);
+            orderbook.addOrder(order);
+            ids.push_back(order.id());
+        }
+        else if (roll < 9) {
+            orderbook.sendCancelOrder(ids[gen() % ids.size()]);
+        }
+        else {
+            orderbook.sendMarketOrder(gen() % 2 == 0, 15);
+        }
+    }
+
+    ConsistentSnapshot snapshot = snapshots.wait();
+    ASSERT_EQ(snapshot.sequence, 300);
+    ASSERT_FALSE(snapshot.late);
+    ASSERT_EQ(snapshot.books.size(), 1);
+    ASSERT_EQ(snapshot.books[0].book, 42);
+    ASSERT_GT(bids.size(), 10);
+    ASSERT_EQ(snapshot.books[0].bids.size(), bids.size());
+    ASSERT_EQ(snapshot.books[0].asks.size(), asks.size());
+    for (size_t i = 0; i < bids.size(); i++)
+    {
+        ASSERT_EQ(snapshot.books[0].bids[i].price, bids[i].price);
+        ASSERT_EQ(snapshot.books[0].bids[i].volume, bids[i].volume);
+        ASSERT_EQ(snapshot.books[0].bids[i].order_count, bids[i].order_count);
+    }
+    for (size_t i = 0; i < asks.size(); i++)
+    {
+        ASSERT_EQ(snapshot.books[0].asks[i].price, asks[i].price);
+        ASSERT_EQ(snapshot.books[0].asks[i].volume, asks[i].volume);
+        ASSERT_EQ(snapshot.books[0].asks[i].order_count, asks[i].order_count);
+    }
+
+    // a request the shard has already passed is flagged
+    ASSERT_TRUE(snapshots.request(10));
+    channel.flush();
+    ASSERT_TRUE(snapshots.wait().late);
+}
+
+TEST(SnapshotTest, TestReplayShardsMatchPrefix)
+{
+    std::vector<uint8_t> data = generateItchMessages(20000, 12, 5);
+    const uint64_t sequence = 12345;
+
+    // the prefix replayed on its own is the expected state at the sequence
+    size_t offset = 0;
+    const uint8_t* body;
+    uint16_t length;
+    for (uint64_t i = 0; i < sequence; i++)
+        nextItchMessage(data.data(), data.size(), offset, body, length);
+    ReplayResult prefix = ReplayEngine{1}.run(data.data(), offset);
+
+    SnapshotCoordinator snapshots{3};
+    ReplayEngine engine{3};
+    engine.setSnapshots(&snapshots);
+    ASSERT_TRUE(snapshots.request(sequence));
+    engine.run(data.data(), data.size());
+    ConsistentSnapshot snapshot = snapshots.wait();
+
+    ASSERT_FALSE(snapshot.late);
+    ASSERT_EQ(snapshot.books.size(), prefix.symbols.size());
+    for (size_t i = 0; i < prefix.symbols.size(); i++)
+    {
+        const SymbolSummary& expected = prefix.symbols[i];
+        const BookSnapshot& book = snapshot.books[i];
+        ASSERT_EQ(book.book, expected.stock_locate);
+
+        uint orders = 0;
+        for (const MarketDataLevel& level : book.bids)
+            orders += level.order_count;
+        for (const MarketDataLevel& level : book.asks)
+            orders += level.order_count;
+        ASSERT_EQ(orders, expected.orders);
+        ASSERT_EQ(book.bids.empty() ? 0 : book.bids[0].price, expected.bid_price);
+        ASSERT_EQ(book.bids.empty() ? 0 : book.bids[0].volume, expected.bid_volume);
+        ASSERT_EQ(book.asks.empty() ? 0 : book.asks[0].price, expected.ask_price);
+        ASSERT_EQ(book.asks.empty() ? 0 : book.asks[0].volume, expected.ask_volume);
+    }
+
+    ASSERT_THROW(ReplayEngine{2}.setSnapshots(&snapshots), std::invalid_argument);
+}
+
+TEST(TraceTest, TestHistogramPercentiles)
+{
+    TraceHistogram histogram;
+    ASSERT_EQ(histogram.percentile(0.5), 0);
+    for (uint64_t cycles = 1; cycles <= 1000; cycles++)
+        histogram.record(cycles);
+
+    ASSERT_EQ(histogram.count, 1000);
+    ASSERT_EQ(histogram.min, 1);
+    ASSERT_EQ(histogram.max, 1000);
+    ASSERT_EQ(histogram.percentile(1.0), 1000);
+    // buckets are under 25% wide
+    ASSERT_GE(histogram.percentile(0.5), 500);
+    ASSERT_LE(histogram.percentile(0.5), 625);
+    ASSERT_GE(histogram.percentile(0.99), 990);
+}
+
+TEST(TraceTest, TestStagesAndRuntimeSwitch)
+{
+    TraceAggregator aggregator;
+    aggregator.drain();
+    OrderBook orderbook{0};
+
+    // switched off, nothing is recorded
+    traceBegin(traceCycles());
+    Order ignored = orderbook.createLevelOrder(true, 10, 0, 90);
+    orderbook.addOrder(ignored);
+    traceEnd();
+    ASSERT_EQ(aggregator.drain(), 0);
+
+    setTracing(true);
+    for (int i = 0; i < 100; i++)
+    {
+        traceBegin(traceCycles());
+        Order order = orderbook.createLevelOrder(i % 2 == 0, 10, 0, 100);
+        orderbook.addOrder(order);
+        tracePoint(TraceStage::Ack);
+        traceEnd();
+    }
+
+    // records from other threads are buffered until drained
+    std::thread worker{[&orderbook] {
+        traceBegin();
+        orderbook.sendMarketOrder(true, 1);
+        traceEnd();
+        for (size_t i = 0; i < __TRACE_BUFFER_SIZE__ + 10; i++)
+        {
+            traceBegin(traceCycles());
+            tracePoint(TraceStage::Ack);
+            traceEnd();
+        }
+    }};
+    worker.join();
+    setTracing(false);
+
+    ASSERT_EQ(aggregator.drain(), 100 + __TRACE_BUFFER_SIZE__);
+    ASSERT_EQ(aggregator.dropped(), 11);
+    ASSERT_EQ(aggregator.histogram(TraceStage::AddOrder).count, 100);
+    ASSERT_EQ(aggregator.histogram(TraceStage::Match).count, 100);
+    ASSERT_EQ(aggregator.histogram(TraceStage::Publish).count, 100);
+    ASSERT_EQ(aggregator.histogram(TraceStage::Receive).count, 0);
+    ASSERT_EQ(aggregator.total().count, 100 + __TRACE_BUFFER_SIZE__ - 1);
+    ASSERT_EQ(aggregator.drain(), 0);
+
+    std::stringstream text;
+    aggregator.dump(text);
+    ASSERT_NE(text.str().find("add_order"), std::string::npos);
+    std::stringstream binary;
+    aggregator.dump(binary, TraceFormat::Binary);
+    ASSERT_EQ(binary.str().substr(0, 4), "OBTR");
+}
+
+TEST(MemoryTest, TestFootprintAccounting)
+{
+    OrderBook orderbook{0};
+    MemoryFootprint empty = orderbook.memory();
+    ASSERT_EQ(empty.orders, orderbook.memory().orders);
+
+    std::vector<uint64_t> ids;
+    for (uint64_t i = 0; i < 1000; i++)
+    {
+        Order o = orderbook.createLevelOrder(true, 10, 0, 100 + i % 200, 1 + i % 10);
+        orderbook.addOrder(o);
+        ids.push_back(o.id());
+    }
+    MemoryFootprint full = orderbook.memory();
+    ASSERT_GT(full.orders, empty.orders);
+    // at least a node per level and per resting order
+    ASSERT_GE(full.levels - empty.levels, 200 * sizeof(OrderBook::LimitEntry));
+    ASSERT_GE(full.indexes - empty.indexes, 1000 * sizeof(OrderBook::OrderIndexEntry));
+    ASSERT_EQ(full.total(), full.orders + full.levels + full.indexes);
+
+    // nodes are freed as soon as levels and orders go, buckets stay
+    for (uint64_t id : ids)
+    {
+        orderbook.sendCancelOrder(id);
+    }
+    MemoryFootprint cancelled = orderbook.memory();
+    ASSERT_LT(cancelled.levels, full.levels);
+    ASSERT_LT(cancelled.indexes, full.indexes);
+    ASSERT_GT(cancelled.levels, empty.levels);
+
+    // within budget compaction does nothing
+    ASSERT_FALSE(orderbook.compact());
+    orderbook.setMemoryBudget(1);
+    ASSERT_TRUE(orderbook.overBudget());
+    while (orderbook.compact())
+    {}
+    MemoryFootprint compacted = orderbook.memory();
+    ASSERT_LT(compacted.levels, cancelled.levels);
+    ASSERT_LT(compacted.indexes, cancelled.indexes);
+}
+
+TEST(MemoryTest, TestCompactionKeepsBook)
+{
+    OrderBook orderbook{0};
+    std::vector<uint64_t> ids;
+    for (uint64_t i = 0; i < 3 * __POOL_CHUNK_SIZE__; i++)
+    {
+        bool is_bid = i % 2 == 0;
+        Order o = orderbook.createLevelOrder(is_bid, 1 + i % 7, 0, is_bid ? 1000 - i % 50 : 1001 + i % 50, 1 + i % 3);
+        orderbook.addOrder(o);
+        ids.push_back(o.id());
+    }
+    size_t orders_bytes = orderbook.memory().orders;
+
+    // leave every eighth order, spread over every chunk
+    std::vector<uint64_t> kept;
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        if (i % 8 == 0)
+            kept.push_back(ids[i]);
+        else
+            orderbook.sendCancelOrder(ids[i]);
+    }
+    uint64_t bid_volume = orderbook.depthVolume(true, 50);
+    uint64_t ask_volume = orderbook.depthVolume(false, 50);
+
+    orderbook.setMemoryBudget(1);
+    size_t steps = 0;
+    while (orderbook.compact(64))
+    {
+        steps++;
+    }
+    ASSERT_GT(steps, 1);
+    ASSERT_LT(orderbook.memory().orders, orders_bytes / 2);
+    ASSERT_EQ(orderbook.size(), kept.size());
+    ASSERT_EQ(orderbook.depthVolume(true, 50), bid_volume);
+    ASSERT_EQ(orderbook.depthVolume(false, 50), ask_volume);
+
+    // moved orders are still found by id, by owner and by the match loop
+    ASSERT_EQ(orderbook.reduceOrder(kept[1], 1), 1);
+    MassCancelResult owner = orderbook.cancelOwnerOrders(1);
+    ASSERT_GT(owner.orders, 0);
+    ASSERT_EQ(orderbook.sendCancelOrder(kept[0]), 0);
+    uint64_t remaining = orderbook.depthVolume(false, 50);
+    ASSERT_EQ(orderbook.sendMarketOrder(true, remaining), remaining);
+    ASSERT_EQ(orderbook.inside_ask_price(), 0);
+    for (uint64_t id : kept)
+    {
+        orderbook.sendCancelOrder(id);
+    }
+    ASSERT_EQ(orderbook.size(), 0);
+}
+
+ClientTask submitOne(AsyncClient& client, ClientOrder order, std::vector<SubmitResult>& results)
+{
+    results.push_back(co_await client.submit(order));
+}
+
+ClientTask submitSequence(AsyncClient& client, uint64_t price, std::vector<SubmitResult>& results)
+{
+    // each ack arrives before the next order is sent
+    for (uint64_t i = 0; i < 3; i++)
+    {
+        results.push_back(co_await client.submit(ClientOrder{true, 10, price + i}));
+        if (results.back().rejected)
+            throw std::runtime_error("rejected");
+    }
+}
+
+TEST(AsyncClientTest, TestPipelinedSubmits)
+{
+    OrderBook orderbook{0};
+    MatchingEngine engine{orderbook};
+    AsyncClient& client = engine.connect();
+    engine.start();
+    ASSERT_THROW(engine.connect(), std::logic_error);
+
+    // more orders than in-flight slots: the rest wait in their frames
+    size_t count = __CLIENT_QUEUE_SIZE__ + 1000;
+    std::vector<SubmitResult> results;
+    results.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        submitOne(client, ClientOrder{false, 1, 100 + i % 10}, results);
+    }
+    ASSERT_EQ(client.in_flight(), __CLIENT_QUEUE_SIZE__);
+    ASSERT_FALSE(client.idle());
+    size_t live = FramePool::local().live();
+    size_t slabs = FramePool::local().slabs();
+    ASSERT_EQ(live, count);
+
+    client.run();
+    ASSERT_EQ(results.size(), count);
+    ASSERT_EQ(FramePool::local().live(), 0);
+
+    // a second wave reuses the pooled frames
+    std::vector<SubmitResult> sweep;
+    sweep.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        submitOne(client, ClientOrder{true, 1, 200}, sweep);
+    }
+    client.run();
+    ASSERT_EQ(FramePool::local().slabs(), slabs);
+    for (const SubmitResult& result : sweep)
+    {
+        ASSERT_FALSE(result.rejected);
+        ASSERT_EQ(result.filled_quantity, 1);
+    }
+    ASSERT_EQ(sweep.front().filled_cost, 100);
+    ASSERT_EQ(sweep.back().filled_cost, 109);
+    ASSERT_EQ(engine.messages(), 2 * count);
+
+    engine.stop();
+    ASSERT_EQ(orderbook.size(), 0);
+}
+
+TEST(AsyncClientTest, TestSequentialAwaitsAndErrors)
+{
+    OrderBook orderbook{0};
+    MatchingEngine engine{orderbook};
+    AsyncClient& client = engine.connect();
+    engine.start();
+
+    std::vector<SubmitResult> results;
+    submitSequence(client, 100, results);
+    ASSERT_EQ(results.size(), 0);
+    client.run();
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_LT(results[0].order_id, results[2].order_id);
+
+    std::vector<SubmitResult> fills;
+    submitOne(client, ClientOrder{false, 25, 101, 0, 5}, fills);
+    client.run();
+    ASSERT_EQ(fills[0].filled_quantity, 20);
+    ASSERT_EQ(fills[0].filled_cost, 10 * 102 + 10 * 101);
+
+    // a rejected order reaches the task, which throws out of poll()
+    std::vector<SubmitResult> rejected;
+    submitSequence(client, 0, rejected);
+    ASSERT_THROW(client.run(), std::runtime_error);
+    ASSERT_TRUE(rejected[0].rejected);
+    ASSERT_TRUE(client.idle());
+
+    // quantities that cannot rest are rejected on the matching thread
+    std::vector<SubmitResult> oversized;
+    submitOne(client, ClientOrder{true, 1ull << 33, 100}, oversized);
+    submitOne(client, ClientOrder{true, 10, 100, 0, 1ull << 33}, oversized);
+    submitOne(client, ClientOrder{true, 10, (1ull << 32) + 101}, oversized);
+    client.run();
+    ASSERT_EQ(oversized.size(), 3);
+    ASSERT_TRUE(oversized[0].rejected);
+    ASSERT_TRUE(oversized[1].rejected);
+    ASSERT_TRUE(oversized[2].rejected);
+
+    engine.stop();
+    ASSERT_EQ(orderbook.depthVolume(false, 1), 5);
+}
+
+TEST(LadderTest, TestKernelsAgree)
+{
+    std::mt19937 random{7};
+    std::vector<uint64_t> volumes(1003);
+    LadderKernel detected = ladderKernel();
+    ASSERT_TRUE(ladderKernelSupported(LadderKernel::Scalar));
+
+    for (int round = 0; round < 200; round++)
+    {
+        // from dense to a few levels scattered over the ladder
+        size_t filled = 1 + random() % 40;
+        std::fill(volumes.begin(), volumes.end(), 0);
+        for (size_t i = 0; i < filled; i++)
+        {
+            volumes[random() % volumes.size()] = 1 + random() % 1000;
+        }
+        size_t from = random() % volumes.size();
+        size_t levels = random() % 50;
+
+        setLadderKernel(LadderKernel::Scalar);
+        size_t found = ladderFindLevel(volumes.data(), from, volumes.size());
+        uint64_t sum = ladderSumLevels(volumes.data(), from, volumes.size(), levels);
+        for (LadderKernel kernel : {LadderKernel::SSE, LadderKernel::AVX2})
+        {
+            if (!ladderKernelSupported(kernel))
+                continue;
+            setLadderKernel(kernel);
+            ASSERT_EQ(ladderFindLevel(volumes.data(), from, volumes.size()), found);
+            ASSERT_EQ(ladderSumLevels(volumes.data(), from, volumes.size(), levels), sum);
+        }
+    }
+    setLadderKernel(detected);
+}
+
+TEST(LadderTest, TestMatchesLevelBook)
+{
+    ASSERT_THROW(LadderBook(10, 9), std::invalid_argument);
+    LadderBook ladder{1000, 1999};
+    MBPBook book;
+    ASSERT_THROW(ladder.applyLevel(true, 2000, 1, 1), std::out_of_range);
+    ASSERT_EQ(ladder.inside_bid_price(), 0);
+    ASSERT_EQ(ladder.inside_ask_volume(), 0);
+
+    auto depth = [&book](bool is_bid, size_t levels) {
+        uint64_t volume = 0;
+        for (const PriceLevel* level = book.best(is_bid); level != nullptr && levels > 0; level = level->next, levels--)
+            volume += level->total_volume();
+        return volume;
+    };
+
+    // levels come and go around a drifting mid, sweeps empty runs from the inside
+    std::mt19937 random{11};
+    for (int i = 0; i < 20000; i++)
+    {
+        bool is_bid = random() % 2;
+        uint64_t mid = 1500 + (i / 1000) * 10;
+        uint64_t price = is_bid ? mid - random() % 300 : mid + 1 + random() % 300;
+        uint64_t volume = random() % 3 == 0 ? 0 : 1 + random() % 100;
+        if (random() % 50 == 0)
+        {
+            // sweep the best few levels of a side
+            const PriceLevel* best = book.best(is_bid);
+            for (int n = 0; n < 5 && best != nullptr; n++)
+            {
+                uint64_t swept = best->price();
+                best = best->next;
+                book.deleteLevel(is_bid, swept);
+                ladder.deleteLevel(is_bid, swept);
+            }
+        }
+        else {
+            book.applyLevel(is_bid, price, volume, 1);
+            ladder.applyLevel(is_bid, price, volume, 1);
+        }
+
+        ASSERT_EQ(ladder.inside_bid_price(), book.inside_bid_price());
+        ASSERT_EQ(ladder.inside_ask_price(), book.inside_ask_price());
+        ASSERT_EQ(ladder.inside_bid_volume(), book.inside_bid_volume());
+        ASSERT_EQ(ladder.size(true), book.size(true));
+        if (i % 100 == 0)
+        {
+            ASSERT_EQ(ladder.depthVolume(true, 10), depth(true, 10));
+            ASSERT_EQ(ladder.depthVolume(false, 37), depth(false, 37));
+        }
+    }
+
+    ladder.clear();
+    ASSERT_EQ(ladder.size(false), 0);
+    ASSERT_EQ(ladder.depthVolume(false, 5), 0);
+}
+
+TEST(RouterTest, TestSweepAcrossBooks)
+{
+    OrderBook lit{0};
+    OrderBook dark{0};
+    OrderBook auction{0};
+    auction.setAuctionMode(true);
+
+    ConsolidatedBook router;
+    ASSERT_EQ(router.addBook(lit), 0);
+    ASSERT_EQ(router.addBook(dark), 1);
+    ASSERT_EQ(router.addBook(auction), 2);
+    ASSERT_EQ(router.inside_ask_price(), 0);
+    ASSERT_EQ(router.inside_book(true), __NO_BOOK__);
+
+    Order l1 = lit.createLevelOrder(false, 10, 0, 101);
+    Order l2 = lit.createLevelOrder(false, 10, 0, 103);
+    Order d1 = dark.createLevelOrder(false, 5, 0, 101);
+    Order d2 = dark.createLevelOrder(false, 10, 0, 102);
+    Order a1 = auction.createLevelOrder(false, 10, 0, 100);
+    Order b1 = dark.createLevelOrder(true, 10, 0, 99);
+    router.addOrder(0, l1);
+    router.addOrder(0, l2);
+    router.addOrder(1, d1);
+    router.addOrder(1, d2);
+    router.addOrder(1, b1);
+    router.addOrder(2, a1);
+
+    // the auction book rests without matching, so it is not routed to
+    ASSERT_EQ(router.inside_ask_price(), 101);
+    ASSERT_EQ(router.inside_book(false), 0);
+    ASSERT_EQ(router.inside_bid_price(), 99);
+    ASSERT_EQ(router.inside_book(true), 1);
+
+    // 101 on lit then dark, then 102 on dark, stopping at the limit
+    RouteResult result = router.route(true, 30, 102);
+    ASSERT_EQ(result.filled_quantity, 25);
+    ASSERT_EQ(result.filled_cost, 10 * 101 + 5 * 101 + 10 * 102);
+    ASSERT_EQ(result.fills.size(), 3);
+    ASSERT_EQ(result.fills[0].book, 0);
+    ASSERT_EQ(result.fills[1].book, 1);
+    ASSERT_EQ(result.fills[1].quantity, 5);
+    ASSERT_EQ(result.fills[2].price, 102);
+    ASSERT_EQ(dark.size(), 1);
+    ASSERT_EQ(router.inside_ask_price(), 103);
+
+    // leaving auction mode exposes the auction book's level once refreshed
+    auction.setAuctionMode(false);
+    router.refresh(2);
+    ASSERT_EQ(router.inside_ask_price(), 100);
+    result = router.sendMarketOrder(true, 100);
+    ASSERT_EQ(result.filled_quantity, 20);
+    ASSERT_EQ(result.fills[0].book, 2);
+    ASSERT_EQ(result.fills[1].price, 103);
+    ASSERT_EQ(router.inside_ask_price(), 0);
+
+    ASSERT_EQ(router.sendCancelOrder(1, b1.id()), 10);
+    ASSERT_EQ(router.inside_bid_price(), 0);
+    ASSERT_EQ(router.route(false, 10, 0).fills.size(), 0);
+}
+
+TEST(RouterTest, TestHeapMatchesBookScan)
+{
+    const size_t num_books = 7;
+    std::vector<std::unique_ptr<OrderBook>> books;
+    ConsolidatedBook router;
+    for (size_t i = 0; i < num_books; i++)
+    {
+        books.push_back(std::make_unique<OrderBook>(0));
+        router.addBook(*books.back());
+    }
+
+    std::mt19937 random{5};
+    std::vector<std::pair<size_t, uint64_t>> resting;
+    for (int i = 0; i < 5000; i++)
+    {
+        size_t book = random() % num_books;
+        int action = random() % 10;
+        if (action < 6)
+        {
+            bool is_bid = random() % 2;
+            uint64_t price = is_bid ? 90 + random() % 15 : 96 + random() % 15;
+            Order order = books[book]->createLevelOrder(is_bid, 1 + random() % 20, 0, price);
+            router.addOrder(book, order);
+            resting.push_back({book, order.id()});
+        }
+        else if (action < 8 && !resting.empty())
+        {
+            size_t pick = random() % resting.size();
+            router.sendCancelOrder(resting[pick].first, resting[pick].second);
+            resting[pick] = resting.back();
+            resting.pop_back();
+        }
+        else {
+            bool is_bid = random() % 2;
+            uint64_t quantity = 1 + random() % 60;
+            uint64_t limit = 93 + random() % 15;
+
+            // a sweep never fills worse than the limit nor out of price order
+            RouteResult result = router.route(is_bid, quantity, limit);
+            ASSERT_LE(result.filled_quantity, quantity);
+            for (size_t f = 0; f < result.fills.size(); f++)
+            {
+                ASSERT_TRUE(is_bid ? result.fills[f].price <= limit : result.fills[f].price >= limit);
+                if (f > 0)
+                {
+                    ASSERT_TRUE(is_bid ? result.fills[f - 1].price <= result.fills[f].price : result.fills[f - 1].price >= result.fills[f].price);
+                }
+            }
+        }
+
+        // best price across books, lowest index among ties
+        for (bool is_bid : {true, false})
+        {
+            uint64_t best = 0;
+            size_t best_book = __NO_BOOK__;
+            for (size_t b = 0; b < num_books; b++)
+            {
+                uint64_t price = is_bid ? books[b]->inside_bid_price() : books[b]->inside_ask_price();
+                if (price != 0 && (best == 0 || (is_bid ? price > best : price < best)))
+                {
+                    best = price;
+                    best_book = b;
+                }
+            }
+            ASSERT_EQ(is_bid ? router.inside_bid_price() : router.inside_ask_price(), best);
+            ASSERT_EQ(router.inside_book(is_bid), best_book);
+        }
+    }
+}